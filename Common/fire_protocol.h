@@ -0,0 +1,366 @@
+#ifndef FIRE_PROTOCOL_H
+#define FIRE_PROTOCOL_H
+
+// Wireless message format shared by the transmitter (detector) and the reciever.
+//
+// Every ESP-NOW packet is one fp_header_t followed by `len` bytes of payload whose layout
+// depends on `type`. Everything is packed and little endian (both ends are ESP32s).
+// Temperatures are int16 tenths of a degree C, bearings are uint16 hundredths of a degree.
+//
+// Bump FP_VERSION whenever a payload layout changes; the reciever drops packets whose
+// version it doesn't know instead of misreading them.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define FP_MAGIC 0xF1
+#define FP_VERSION 7
+#define FP_MAX_PACKET 250               // ESP_NOW_MAX_DATA_LEN
+// leaves room for the relay trailer, so any packet can be forwarded
+#define FP_MAX_PAYLOAD (FP_MAX_PACKET - sizeof(fp_header_t) - sizeof(fp_relay_t))
+#define FP_DEFAULT_TTL 3                // hops a message may take through relays
+
+#define FP_FLAG_RELAYED 0x01            // an fp_relay_t trailer follows the payload
+
+typedef enum {
+    FP_MSG_STATUS = 1,      // per frame while not OK or on a state change: state and frame min/max
+    FP_MSG_ALERT = 2,       // warning or fire, with where and how big
+    FP_MSG_HEARTBEAT = 3,   // "still alive", every period_s while all is quiet
+    FP_MSG_TELEMETRY = 4,   // processing counters
+    FP_MSG_TEXT = 5,        // free-form log line (boot messages etc.)
+    FP_MSG_COMMAND = 6,     // reciever -> detector request
+    FP_MSG_PANO = 7,        // one run of panorama cells
+    FP_MSG_LINK = 8,        // delivery counters for the radio link
+    FP_MSG_FRAME_FRAG = 9,  // one fragment of a full thermal frame
+    FP_MSG_BATCH = 10,      // several small messages in one packet, see fp_record_t
+    FP_MSG_RELAY_STATS = 11,    // forwarding counters from a relay node
+    FP_MSG_SCAN_STATS = 12,     // per scan position risk and revisit intervals
+    FP_MSG_PERF = 13,           // timing of the detector's processing stages, on request
+    FP_MSG_POWER = 14,          // power mode, current per mode and battery estimate
+    FP_MSG_BLACKBOX = 15,       // one fragment of a frame from the black box, after an alarm
+} fp_type_t;
+
+typedef enum {
+    FP_STATE_BOOT = 0,
+    FP_STATE_OK = 1,
+    FP_STATE_WARNING = 2,
+    FP_STATE_FIRE = 3,
+} fp_state_t;
+
+typedef enum {
+    FP_CMD_SEND_PANO = 1,   // dump the 360 panorama
+    FP_CMD_STREAM_ON = 2,   // stream every frame, not just while alarmed
+    FP_CMD_STREAM_OFF = 3,
+    FP_CMD_SEND_PERF = 4,   // timing stats, answered with FP_MSG_PERF
+    FP_CMD_BLACKBOX = 5,    // dump the black box now, as if there had been an alarm
+} fp_command_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t magic;
+    uint8_t version;
+    uint8_t type;           // fp_type_t
+    uint8_t flags;
+    uint16_t seq;           // per sender, wraps
+    uint8_t len;            // payload bytes after the header
+} fp_header_t;
+
+// Added after the payload (not counted in len) by the first relay that forwards a packet, so
+// the receiver knows who really sent it. Each relay decrements ttl, increments hops and adds
+// the time the packet spent inside it.
+typedef struct __attribute__((packed)) {
+    uint8_t origin[6];      // MAC of the detector that sent it
+    uint8_t ttl;            // forwards left
+    uint8_t hops;
+    uint16_t fwd_100us;     // summed time spent in relays, 0.1 ms units (saturates)
+} fp_relay_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t state;          // fp_state_t
+    int8_t pos;             // scan position
+    int16_t t_max;
+    int16_t t_min;
+    int16_t ta;
+    uint16_t t_max_bearing;
+} fp_status_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t level;          // FP_STATE_WARNING or FP_STATE_FIRE
+    uint8_t confidence;     // 0-100
+    uint8_t track_id;       // 0 if not tracked yet
+    uint8_t track_class;    // track_class_t on the detector
+    int16_t peak;
+    uint16_t bearing;
+    uint16_t blob_px;
+} fp_alert_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t uptime_s;
+    uint8_t state;          // fp_state_t
+    uint8_t period_s;       // next heartbeat due within this long, the reciever times out on it
+} fp_heartbeat_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t frames;
+    uint16_t frame_ms;      // time spent processing the last frame
+    uint8_t tiles_calc;     // tiles calibrated in the last frame (of 48)
+    uint8_t tracks;         // confirmed tracks
+    uint16_t tx_fail;       // sends that weren't acked since boot
+    int16_t ta;
+} fp_telemetry_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t delivered;     // packets acked since boot
+    uint16_t retries;       // resends since boot
+    uint16_t gave_up;       // packets dropped after running out of retries
+    uint16_t dropped;       // packets pushed out of the send slots by an alert, never sent
+    uint16_t alert_p99_ms;      // queue -> ack of alerts, 99th percentile (bucketed)
+    uint16_t alert_max_ms;
+    uint16_t latency_p99_ms;    // same for status, telemetry and the other routine traffic
+    uint16_t latency_max_ms;
+    uint16_t queue_dropped;     // messages the transmit queue had no room for
+    uint8_t queue_high_water;   // deepest the transmit queues have been (all priorities)
+    uint8_t status_coalesced;   // status updates replaced by a newer one before sending (wraps)
+} fp_link_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t forwarded;
+    uint16_t duplicates;        // already forwarded (or our own, looped back)
+    uint16_t ttl_expired;
+    uint16_t queue_full;
+    uint16_t latency_avg_100us; // receive -> handed to the radio, per hop
+    uint16_t latency_max_100us;
+} fp_relay_stats_t;
+
+#define FP_SCAN_MAX_POSITIONS 15             // 2 * CONFIG_HEAD_POSITIONS_EACH_SIDE + 1 at most
+
+// times in tenths of a second, entry i is scan position first_pos + i
+typedef struct __attribute__((packed)) {
+    int8_t first_pos;
+    uint8_t positions;
+    uint8_t risk_pct[FP_SCAN_MAX_POSITIONS];
+    uint16_t target_ds[FP_SCAN_MAX_POSITIONS];          // revisit interval the scheduler aims for
+    uint16_t last_revisit_ds[FP_SCAN_MAX_POSITIONS];
+    uint16_t worst_revisit_ds[FP_SCAN_MAX_POSITIONS];   // since boot
+} fp_scan_stats_t;
+
+// one timer of the detector's: a pipeline stage or a probe inside one
+typedef struct __attribute__((packed)) {
+    char name[10];          // not nul terminated if it's all 10
+    uint32_t count;
+    uint16_t misses;        // over the deadline (saturates)
+    uint32_t deadline_us;
+    uint32_t max_us;
+    uint32_t p50_us;        // upper edges of power-of-two buckets, so up to 2x high
+    uint32_t p99_us;
+} fp_perf_entry_t;
+
+// timers first .. first+count-1 of total, the rest come in the next message(s)
+typedef struct __attribute__((packed)) {
+    uint8_t first;
+    uint8_t total;
+    uint8_t count;
+    fp_perf_entry_t entries[];
+} fp_perf_t;
+
+#define FP_PERF_MAX_ENTRIES ((FP_MAX_PAYLOAD - sizeof(fp_perf_t)) / sizeof(fp_perf_entry_t))
+
+// currents in tenths of a mA; unless `measured`, they're datasheet estimates, not readings
+typedef struct __attribute__((packed)) {
+    uint8_t mode;           // 0 full rate, 1 sentinel
+    uint8_t measured;
+    uint16_t ma_full;
+    uint16_t ma_sentinel;
+    uint16_t ma_avg;        // weighted by the time spent in each mode
+    uint32_t full_s;        // time in each mode since boot
+    uint32_t sentinel_s;
+    uint16_t escalations;   // sentinel -> full rate
+    uint16_t runtime_h;     // battery life at ma_avg
+} fp_power_t;
+
+// The black box (transmitter blackbox.c) keeps the last few dozen frames, each one a
+// thermal_codec keyframe so it decodes on its own. After an alarm they're sent oldest first,
+// then the frames that came after it. Fragments work like fp_frag_t: fragment i holds bytes
+// [i * FP_BLACKBOX_MAX_DATA, ...) and crc is over the fragment with the crc field zeroed.
+#define FP_BLACKBOX_MAX_DATA (FP_MAX_PAYLOAD - sizeof(fp_blackbox_t))
+
+typedef struct __attribute__((packed)) {
+    uint8_t incident;       // counts up with every dump (wraps)
+    uint8_t frame;          // in time order within the incident (wraps)
+    int32_t t_ms;           // relative to the alarm, negative before it
+    int32_t motor_steps;    // stepper position when the frame was taken
+    int8_t pos;             // scan position
+    uint8_t state;          // fp_state_t of the frame
+    int16_t t_max;
+    uint16_t bearing;
+    uint8_t index;          // fragment number, 0 .. count-1
+    uint8_t count;
+    uint16_t crc;
+    uint8_t data[];         // thermal_codec keyframe
+} fp_blackbox_t;
+
+// FP_MSG_BATCH payload is a run of these back to back, each with its own type and length.
+// Used for small periodic records (telemetry, link stats) that don't need a packet each.
+typedef struct __attribute__((packed)) {
+    uint8_t type;           // fp_type_t, never FP_MSG_BATCH
+    uint8_t len;
+    uint8_t data[];
+} fp_record_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;            // fp_command_t
+} fp_cmd_t;
+
+#define FP_PANO_MAX_CELLS ((FP_MAX_PAYLOAD - 3) / 2)
+#define FP_PANO_UNSEEN INT16_MIN
+
+typedef struct __attribute__((packed)) {
+    uint8_t row;
+    uint8_t col;            // first column in this run
+    uint8_t count;
+    int16_t cells[];        // FP_PANO_UNSEEN for columns never looked at
+} fp_pano_t;
+
+// Thermal frames are compressed with Common/thermal_codec (one coded frame is at most
+// TC_MAX_ENCODED = 1540 bytes, usually a few hundred) and the coded bytes are split into
+// fragments of up to FP_FRAG_MAX_DATA bytes; fragment i holds bytes [i * FP_FRAG_MAX_DATA, ...).
+// crc is fp_crc16 over the fragment with the crc field zeroed, so a fragment that got
+// mangled can't poison a frame.
+#define FP_FRAG_MAX_DATA (FP_MAX_PAYLOAD - 8)
+#define FP_FRAG_MAX_COUNT 31
+
+typedef struct __attribute__((packed)) {
+    uint16_t frame_id;      // per sender, wraps
+    uint8_t index;          // fragment number, 0 .. count-1
+    uint8_t count;          // fragments in this frame
+    uint16_t bearing;       // where the head was pointing
+    uint16_t crc;
+    uint8_t data[];         // thermal_codec bytes
+} fp_frag_t;
+
+// smallest payload each type can have, used to reject truncated packets
+static inline size_t fp_min_payload(uint8_t type) {
+    switch (type) {
+        case FP_MSG_STATUS: return sizeof(fp_status_t);
+        case FP_MSG_ALERT: return sizeof(fp_alert_t);
+        case FP_MSG_HEARTBEAT: return sizeof(fp_heartbeat_t);
+        case FP_MSG_TELEMETRY: return sizeof(fp_telemetry_t);
+        case FP_MSG_TEXT: return 0;
+        case FP_MSG_COMMAND: return sizeof(fp_cmd_t);
+        case FP_MSG_PANO: return sizeof(fp_pano_t);
+        case FP_MSG_LINK: return sizeof(fp_link_t);
+        case FP_MSG_FRAME_FRAG: return sizeof(fp_frag_t);
+        case FP_MSG_BATCH: return sizeof(fp_record_t);
+        case FP_MSG_RELAY_STATS: return sizeof(fp_relay_stats_t);
+        case FP_MSG_SCAN_STATS: return sizeof(fp_scan_stats_t);
+        case FP_MSG_PERF: return sizeof(fp_perf_t);
+        case FP_MSG_POWER: return sizeof(fp_power_t);
+        case FP_MSG_BLACKBOX: return sizeof(fp_blackbox_t);
+        default: return SIZE_MAX;
+    }
+}
+
+// fills in a header, returns the full packet length
+static inline size_t fp_init_header(fp_header_t *h, uint8_t type, uint16_t seq, size_t len) {
+    h->magic = FP_MAGIC;
+    h->version = FP_VERSION;
+    h->type = type;
+    h->flags = 0;
+    h->seq = seq;
+    h->len = (uint8_t)len;
+    return sizeof(fp_header_t) + len;
+}
+
+// Checks a received packet and returns its header, or NULL if it isn't one of ours, is from
+// a protocol version we don't speak, or is shorter than its header says. The payload starts
+// right after the header.
+static inline const fp_header_t *fp_parse(const uint8_t *data, int len) {
+    const fp_header_t *h = (const fp_header_t *)data;
+    if (len < (int)sizeof(fp_header_t)) return NULL;
+    if (h->magic != FP_MAGIC || h->version != FP_VERSION) return NULL;
+    if ((int)sizeof(fp_header_t) + h->len > len) return NULL;
+    if (h->len < fp_min_payload(h->type)) return NULL;
+    return h;
+}
+
+static inline const void *fp_payload(const fp_header_t *h) {
+    return (const uint8_t *)h + sizeof(fp_header_t);
+}
+
+// relay trailer of a packet of len bytes, or NULL if it was never relayed
+static inline const fp_relay_t *fp_relay_info(const fp_header_t *h, int len) {
+    if (!(h->flags & FP_FLAG_RELAYED)) return NULL;
+    if ((int)(sizeof(fp_header_t) + h->len + sizeof(fp_relay_t)) > len) return NULL;
+    return (const fp_relay_t *)((const uint8_t *)h + sizeof(fp_header_t) + h->len);
+}
+
+// Walks the records of an FP_MSG_BATCH: pass *offset = 0 first, returns NULL at the end or at
+// a record that runs past the payload or is too short for its type.
+static inline const fp_record_t *fp_next_record(const fp_header_t *h, size_t *offset) {
+    const uint8_t *p = (const uint8_t *)fp_payload(h);
+    if (*offset + sizeof(fp_record_t) > h->len) return NULL;
+    const fp_record_t *r = (const fp_record_t *)(p + *offset);
+    if (*offset + sizeof(fp_record_t) + r->len > h->len) return NULL;
+    if (r->type == FP_MSG_BATCH || r->len < fp_min_payload(r->type)) return NULL;
+    *offset += sizeof(fp_record_t) + r->len;
+    return r;
+}
+
+// CRC-16/CCITT-FALSE, bitwise since it only runs over a few hundred bytes per packet
+static inline uint16_t fp_crc16(const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint16_t crc = 0xFFFF;
+    while (len--) {
+        crc ^= (uint16_t)(*p++) << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// crc of a fragment as sent, i.e. with its crc field taken as zero
+static inline uint16_t fp_frag_crc(const fp_frag_t *f, size_t len) {
+    uint8_t tmp[FP_MAX_PAYLOAD];
+    if (len > sizeof(tmp)) len = sizeof(tmp);
+    memcpy(tmp, f, len);
+    ((fp_frag_t *)tmp)->crc = 0;
+    return fp_crc16(tmp, len);
+}
+
+// same for a black box fragment
+static inline uint16_t fp_blackbox_crc(const fp_blackbox_t *f, size_t len) {
+    uint8_t tmp[FP_MAX_PAYLOAD];
+    if (len > sizeof(tmp)) len = sizeof(tmp);
+    memcpy(tmp, f, len);
+    ((fp_blackbox_t *)tmp)->crc = 0;
+    return fp_crc16(tmp, len);
+}
+
+// float C -> tenths of a degree, saturating
+static inline int16_t fp_deci(float c) {
+    float v = c * 10.0f;
+    if (v > 32767.0f) return 32767;
+    if (v < -32767.0f) return -32767;
+    return (int16_t)(v < 0 ? v - 0.5f : v + 0.5f);
+}
+
+// bearing in degrees (0-360) -> hundredths of a degree
+static inline uint16_t fp_cdeg(float deg) {
+    int v = (int)(deg * 100.0f + 0.5f);
+    v %= 36000;
+    if (v < 0) v += 36000;
+    return (uint16_t)v;
+}
+
+static inline const char *fp_state_name(uint8_t state) {
+    switch (state) {
+        case FP_STATE_BOOT: return "booting";
+        case FP_STATE_OK: return "all is good";
+        case FP_STATE_WARNING: return "WARNING";
+        case FP_STATE_FIRE: return "FIRE";
+        default: return "?";
+    }
+}
+
+#endif // FIRE_PROTOCOL_H
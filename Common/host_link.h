@@ -0,0 +1,106 @@
+#ifndef HOST_LINK_H
+#define HOST_LINK_H
+
+// Binary serial link from the reciever to a host gateway, used instead of the text console
+// when the reciever is built with HOST_LINK_BINARY. Host/link_decoder.h is the decoder.
+//
+// Every message is
+//     type (hl_type_t), seq (per link, wraps), body, crc16 (fp_crc16 of type..body, LE)
+// COBS encoded, with a 0x00 before and after it. COBS never puts a 0 inside a message, so
+// after a dropped byte or line noise the host only has to wait for the next 0 to be back in
+// sync (the leading one keeps noise between messages from spoiling the next message);
+// the CRC catches what's left and a gap in seq shows messages lost on the way.
+// Radio messages are passed on as the radio packet itself (fire_protocol.h), so the host
+// uses the same types and structs as the reciever.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "fire_protocol.h"
+#include "thermal_codec.h"
+
+#define HL_BAUD_DEFAULT 921600
+#define HL_DELIMITER 0x00
+
+typedef enum {
+    HL_MSG_PACKET = 1,      // hl_packet_t + one accepted radio packet (header + payload)
+    HL_MSG_FRAME = 2,       // hl_frame_t + a whole reassembled thermal_codec frame
+    HL_MSG_NODE = 3,        // hl_node_t: a detector went offline or came back
+    HL_MSG_TEXT = 4,        // console text (key commands, warnings), not null terminated
+} hl_type_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t node;           // node table slot on the reciever
+    uint8_t mac[6];         // detector that sent it (the origin, if relayed)
+    int8_t rssi;            // of the last hop
+    uint8_t hops;           // relays it went through
+    uint32_t rx_ms;         // reciever uptime when it arrived
+    uint8_t packet[];       // fp_header_t + payload, relay trailer stripped
+} hl_packet_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t node;
+    uint16_t frame_id;
+    uint16_t bearing;       // hundredths of a degree
+    uint16_t len;           // coded bytes
+    uint32_t rx_ms;         // when the last fragment arrived
+    uint8_t data[];         // decode with tc_decode, one decoder per node
+} hl_frame_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t node;
+    uint8_t mac[6];
+    uint8_t online;         // 0 = just timed out, 1 = heard from again
+    uint8_t state;          // fp_state_t it was last in
+    uint32_t silent_ms;     // offline: since it was last heard, online: how long it was offline
+} hl_node_t;
+
+#define HL_HEADER_BYTES 2
+#define HL_CRC_BYTES 2
+#define HL_MAX_BODY (sizeof(hl_frame_t) + TC_MAX_ENCODED)
+#define HL_MAX_RAW (HL_HEADER_BYTES + HL_MAX_BODY + HL_CRC_BYTES)
+// COBS adds one byte per 254 plus one, then the two delimiters
+#define HL_MAX_ENCODED (HL_MAX_RAW + HL_MAX_RAW / 254 + 3)
+
+// COBS: every run of up to 254 non-zero bytes is prefixed with its length + 1, a code below
+// 0xFF also stands for the 0 that ended the run. Returns the encoded length, no delimiter.
+static inline size_t hl_cobs_encode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t code_at = 0, o = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[code_at] = code;
+            code_at = o++;
+            code = 1;
+            continue;
+        }
+        out[o++] = in[i];
+        if (++code == 0xFF) {
+            out[code_at] = code;
+            code_at = o++;
+            code = 1;
+        }
+    }
+    out[code_at] = code;
+    return o;
+}
+
+// Undoes hl_cobs_encode (without the delimiter). Returns the decoded length, or -1 if the
+// input isn't valid COBS or doesn't fit in out_size.
+static inline int hl_cobs_decode(const uint8_t *in, size_t len, uint8_t *out, size_t out_size) {
+    size_t i = 0, o = 0;
+    while (i < len) {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > len) return -1;
+        for (uint8_t k = 1; k < code; k++) {
+            if (o >= out_size) return -1;
+            out[o++] = in[i++];
+        }
+        if (code < 0xFF && i < len) {
+            if (o >= out_size) return -1;
+            out[o++] = 0;
+        }
+    }
+    return (int)o;
+}
+
+#endif // HOST_LINK_H
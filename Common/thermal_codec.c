@@ -0,0 +1,270 @@
+#include <string.h>
+#include "thermal_codec.h"
+
+#define RICE_ESCAPE 16      // quotients this big are sent as RICE_ESCAPE ones + ESCAPE_BITS raw
+#define ESCAPE_BITS 18      // enough for any zigzagged int16 difference
+#define RICE_MAX_K 15
+#define CONTEXT_RESET 64    // halve the running stats every this many pixels so k keeps adapting
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t pos;
+    uint32_t acc;
+    int nbits;
+    bool overflow;
+} bit_writer_t;
+
+typedef struct {
+    const uint8_t *buf;
+    size_t size;
+    size_t pos;
+    uint32_t acc;
+    int nbits;
+    bool underflow;
+} bit_reader_t;
+
+// running mean of |residual| (JPEG-LS style A/N), picks the Rice parameter
+typedef struct {
+    uint32_t a;
+    uint32_t n;
+} rice_ctx_t;
+
+static void put_bits(bit_writer_t *w, uint32_t value, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+        w->acc = (w->acc << 1) | ((value >> i) & 1);
+        if (++w->nbits == 8) {
+            if (w->pos >= w->size) {
+                w->overflow = true;
+            } else {
+                w->buf[w->pos++] = (uint8_t)w->acc;
+            }
+            w->acc = 0;
+            w->nbits = 0;
+        }
+    }
+}
+
+static void flush_bits(bit_writer_t *w) {
+    if (w->nbits) put_bits(w, 0, 8 - w->nbits);
+}
+
+static uint32_t get_bits(bit_reader_t *r, int count) {
+    uint32_t v = 0;
+    for (int i = 0; i < count; i++) {
+        if (r->nbits == 0) {
+            if (r->pos >= r->size) {
+                r->underflow = true;
+                return 0;
+            }
+            r->acc = r->buf[r->pos++];
+            r->nbits = 8;
+        }
+        r->nbits--;
+        v = (v << 1) | ((r->acc >> r->nbits) & 1);
+    }
+    return v;
+}
+
+static int rice_k(const rice_ctx_t *ctx) {
+    int k = 0;
+    while (k < RICE_MAX_K && (ctx->n << k) < ctx->a) k++;
+    return k;
+}
+
+static void rice_update(rice_ctx_t *ctx, uint32_t u) {
+    ctx->a += u;
+    if (++ctx->n >= CONTEXT_RESET) {
+        ctx->a >>= 1;
+        ctx->n >>= 1;
+    }
+}
+
+static void rice_put(bit_writer_t *w, rice_ctx_t *ctx, uint32_t u) {
+    int k = rice_k(ctx);
+    uint32_t q = u >> k;
+    if (q >= RICE_ESCAPE) {
+        put_bits(w, (1u << RICE_ESCAPE) - 1, RICE_ESCAPE);
+        put_bits(w, u, ESCAPE_BITS);
+    } else {
+        put_bits(w, ((1u << q) - 1) << 1, q + 1);  // q ones then a zero
+        put_bits(w, u & ((1u << k) - 1), k);
+    }
+    rice_update(ctx, u);
+}
+
+static uint32_t rice_get(bit_reader_t *r, rice_ctx_t *ctx) {
+    int k = rice_k(ctx);
+    uint32_t q = 0, u;
+    while (q < RICE_ESCAPE && get_bits(r, 1)) q++;
+    if (q >= RICE_ESCAPE) {
+        u = get_bits(r, ESCAPE_BITS);
+    } else {
+        u = (q << k) | get_bits(r, k);
+    }
+    rice_update(ctx, u);
+    return u;
+}
+
+static uint32_t zigzag(int32_t v) {
+    return v < 0 ? ((uint32_t)(-v) << 1) - 1 : (uint32_t)v << 1;
+}
+
+static int32_t unzigzag(uint32_t u) {
+    return (u & 1) ? -(int32_t)((u + 1) >> 1) : (int32_t)(u >> 1);
+}
+
+// median edge detector from LOCO-I: picks a, b or a+b-c depending on whether there's an edge
+static int32_t med(int32_t a, int32_t b, int32_t c) {
+    int32_t lo = a < b ? a : b;
+    int32_t hi = a < b ? b : a;
+    if (c >= hi) return lo;
+    if (c <= lo) return hi;
+    return a + b - c;
+}
+
+static int16_t clamp16(int32_t v) {
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return (int16_t)v;
+}
+
+// Prediction for pixel i from what is already reconstructed. Keyframes predict the value
+// from its neighbours, delta frames predict the change since the last frame from how the
+// neighbours changed, so a warm object that stays put costs next to nothing.
+static int32_t predict(const int16_t *recon, const int16_t *prev, bool key, int i) {
+    int r = i / TC_COLS, c = i % TC_COLS;
+    int32_t a, b, d;
+    if (key) {
+        if (r == 0 && c == 0) return 0;
+        if (r == 0) return recon[i - 1];
+        if (c == 0) return recon[i - TC_COLS];
+        a = recon[i - 1];
+        b = recon[i - TC_COLS];
+        d = recon[i - TC_COLS - 1];
+        return med(a, b, d);
+    }
+    if (r == 0 && c == 0) return prev[i];
+    if (r == 0) return prev[i] + recon[i - 1] - prev[i - 1];
+    if (c == 0) return prev[i] + recon[i - TC_COLS] - prev[i - TC_COLS];
+    a = recon[i - 1] - prev[i - 1];
+    b = recon[i - TC_COLS] - prev[i - TC_COLS];
+    d = recon[i - TC_COLS - 1] - prev[i - TC_COLS - 1];
+    return prev[i] + med(a, b, d);
+}
+
+// float C -> tenths of a degree, rounded and saturated
+void tc_quantize(const float *image, int16_t *cells) {
+    for (int i = 0; i < TC_CELLS; i++) {
+        float v = image[i] * 10.0f;
+        if (v > 32767.0f) v = 32767.0f;
+        if (v < -32767.0f) v = -32767.0f;
+        cells[i] = (int16_t)(v < 0 ? v - 0.5f : v + 0.5f);
+    }
+}
+
+void tc_encoder_init(tc_encoder_t *enc, int keyframe_interval, int max_error) {
+    memset(enc, 0, sizeof(*enc));
+    enc->keyframe_interval = keyframe_interval;
+    enc->max_error = max_error;
+}
+
+// next frame goes out as a keyframe, e.g. after the reciever may have lost one
+void tc_encoder_force_keyframe(tc_encoder_t *enc) {
+    enc->force_key = true;
+}
+
+static int encode_raw(tc_encoder_t *enc, const int16_t *cells, uint8_t *out, size_t out_size) {
+    if (out_size < TC_MAX_ENCODED) return TC_ERR_TRUNCATED;
+    out[0] = TC_FLAG_KEY | TC_FLAG_RAW;
+    out[1] = 0;
+    for (int i = 0; i < TC_CELLS; i++) {
+        out[TC_HEADER_BYTES + 2*i] = (uint8_t)cells[i];
+        out[TC_HEADER_BYTES + 2*i + 1] = (uint8_t)((uint16_t)cells[i] >> 8);
+    }
+    memcpy(enc->recon, cells, sizeof(enc->recon));
+    return TC_MAX_ENCODED;
+}
+
+// Codes one frame into out, returns the number of bytes or a TC_ERR_*. out_size of
+// TC_MAX_ENCODED is always enough.
+int tc_encode(tc_encoder_t *enc, const int16_t *cells, uint8_t *out, size_t out_size) {
+    bool key = !enc->have_prev || enc->force_key ||
+               (enc->keyframe_interval && enc->frame_no % enc->keyframe_interval == 0);
+    int step = 2 * enc->max_error + 1;
+    rice_ctx_t ctx = { 4, 1 };
+    int n;
+
+    if (out_size < TC_HEADER_BYTES) return TC_ERR_TRUNCATED;
+
+    // stop coding as soon as it's clear the plain frame would be smaller
+    bit_writer_t w = { out + TC_HEADER_BYTES, out_size - TC_HEADER_BYTES, 0, 0, 0, false };
+    if (w.size > TC_CELLS * 2) w.size = TC_CELLS * 2;
+
+    for (int i = 0; i < TC_CELLS && !w.overflow; i++) {
+        int32_t pred = predict(enc->recon, enc->prev, key, i);
+        int32_t e = cells[i] - pred;
+        // near-lossless: quantize the error so the reconstruction is within max_error
+        int32_t q = (e >= 0) ? (e + enc->max_error) / step : -((-e + enc->max_error) / step);
+        enc->recon[i] = clamp16(pred + q * step);
+        rice_put(&w, &ctx, zigzag(q));
+    }
+    flush_bits(&w);
+
+    if (w.overflow) {
+        n = encode_raw(enc, cells, out, out_size);
+        if (n < 0) return n;
+    } else {
+        out[0] = key ? TC_FLAG_KEY : 0;
+        out[1] = enc->max_error;
+        n = TC_HEADER_BYTES + (int)w.pos;
+    }
+    out[2] = (uint8_t)enc->frame_no;
+    out[3] = (uint8_t)(enc->frame_no >> 8);
+
+    memcpy(enc->prev, enc->recon, sizeof(enc->prev));
+    enc->have_prev = true;
+    enc->force_key = false;
+    enc->frame_no++;
+    return n;
+}
+
+void tc_decoder_init(tc_decoder_t *dec) {
+    memset(dec, 0, sizeof(*dec));
+}
+
+// Decodes one coded frame into cells. On an error cells is left untouched and the decoder
+// keeps its reference, so a broken frame doesn't take the following ones down with it.
+int tc_decode(tc_decoder_t *dec, const uint8_t *in, size_t len, int16_t *cells) {
+    int16_t *recon = dec->recon;
+    if (len < TC_HEADER_BYTES) return TC_ERR_TRUNCATED;
+    uint8_t flags = in[0];
+    int step = 2 * in[1] + 1;
+    uint16_t frame_no = in[2] | (in[3] << 8);
+    bool key = flags & TC_FLAG_KEY;
+
+    if (flags & ~(TC_FLAG_KEY | TC_FLAG_RAW)) return TC_ERR_BAD_HEADER;
+    if (!key && (!dec->have_prev || (uint16_t)(dec->frame_no + 1) != frame_no)) return TC_ERR_NO_REF;
+
+    if (flags & TC_FLAG_RAW) {
+        if (len < TC_MAX_ENCODED) return TC_ERR_TRUNCATED;
+        for (int i = 0; i < TC_CELLS; i++) {
+            recon[i] = (int16_t)(in[TC_HEADER_BYTES + 2*i] | (in[TC_HEADER_BYTES + 2*i + 1] << 8));
+        }
+    } else {
+        bit_reader_t r = { in + TC_HEADER_BYTES, len - TC_HEADER_BYTES, 0, 0, 0, false };
+        rice_ctx_t ctx = { 4, 1 };
+        for (int i = 0; i < TC_CELLS; i++) {
+            int32_t pred = predict(recon, dec->prev, key, i);
+            int32_t q = unzigzag(rice_get(&r, &ctx));
+            recon[i] = clamp16(pred + q * step);
+        }
+        if (r.underflow) return TC_ERR_TRUNCATED;
+    }
+
+    memcpy(dec->prev, recon, sizeof(dec->prev));
+    memcpy(cells, recon, sizeof(dec->prev));
+    dec->have_prev = true;
+    dec->frame_no = frame_no;
+    return TC_OK;
+}
@@ -0,0 +1,70 @@
+#ifndef THERMAL_CODEC_H
+#define THERMAL_CODEC_H
+
+// Frame codec for 32x24 MLX90640 images, shared by the detector, the reciever and the
+// host tools in Host/.
+//
+// Temperatures go in as int16 tenths of a degree C (see tc_quantize). Each pixel is predicted
+// from the previous frame plus how its left/top neighbours changed since then (keyframes:
+// from the left/top neighbours only, LOCO-I style), the prediction error is zigzagged and
+// written with an adaptive Golomb-Rice code. max_error = 0 is lossless; max_error = n lets
+// every decoded pixel be off by up to n tenths of a degree in exchange for fewer bytes.
+// A frame that would come out bigger than the plain int16 image is stored plain instead, so
+// a coded frame is never more than TC_MAX_ENCODED bytes.
+//
+// Coded frame layout: flags (TC_FLAG_*), max_error, uint16 frame_no (little endian), bits.
+// A delta frame only decodes if the decoder's last frame was frame_no - 1; after a loss the
+// decoder waits for the next keyframe.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TC_ROWS 24
+#define TC_COLS 32
+#define TC_CELLS (TC_ROWS * TC_COLS)
+#define TC_HEADER_BYTES 4
+#define TC_MAX_ENCODED (TC_HEADER_BYTES + TC_CELLS * 2)
+
+#define TC_FLAG_KEY 0x01            // no reference to the previous frame
+#define TC_FLAG_RAW 0x02            // plain little endian int16 cells, no prediction
+
+#define TC_OK 0
+#define TC_ERR_TRUNCATED -1         // ran out of input / output space
+#define TC_ERR_NO_REF -2            // delta frame but we don't have the frame before it
+#define TC_ERR_BAD_HEADER -3
+
+typedef struct {
+    int16_t prev[TC_CELLS];         // what the decoder will have for the last frame
+    int16_t recon[TC_CELLS];        // scratch for the frame being coded
+    bool have_prev;
+    bool force_key;
+    uint16_t frame_no;
+    uint8_t keyframe_interval;      // every n-th frame is a keyframe, 0 = only the first
+    uint8_t max_error;              // tenths of a degree, 0 = lossless
+} tc_encoder_t;
+
+typedef struct {
+    int16_t prev[TC_CELLS];
+    int16_t recon[TC_CELLS];
+    bool have_prev;
+    uint16_t frame_no;              // of prev
+} tc_decoder_t;
+
+// Function Declarations
+void tc_quantize(const float *image, int16_t *cells);
+void tc_encoder_init(tc_encoder_t *enc, int keyframe_interval, int max_error);
+void tc_encoder_force_keyframe(tc_encoder_t *enc);
+int tc_encode(tc_encoder_t *enc, const int16_t *cells, uint8_t *out, size_t out_size);
+void tc_decoder_init(tc_decoder_t *dec);
+int tc_decode(tc_decoder_t *dec, const uint8_t *in, size_t len, int16_t *cells);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // THERMAL_CODEC_H
@@ -0,0 +1,138 @@
+// Compression ratio and speed of the thermal frame codec on recorded sessions.
+//
+//   codec_bench [-e max_error] [-k keyframe_interval] session.log ...
+//   codec_bench --synthetic 2000
+//
+// Speeds are MB/s of int16 frame data (1536 bytes/frame) on this machine, not the ESP32.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "session.h"
+#include "thermal_codec.h"
+
+struct bench_result {
+    size_t coded_bytes = 0;
+    int keyframes = 0;
+    int raw_frames = 0;
+    int max_abs_error = 0;
+    double encode_mb_s = 0;
+    double decode_mb_s = 0;
+};
+
+// repeats fn until it has run for at least min_seconds, returns seconds per run
+template <typename F>
+static double time_per_run(F fn, double min_seconds = 0.3) {
+    using clock = std::chrono::steady_clock;
+    int runs = 0;
+    auto start = clock::now();
+    double elapsed;
+    do {
+        fn();
+        runs++;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    } while (elapsed < min_seconds);
+    return elapsed / runs;
+}
+
+static bench_result run(const std::vector<thermal_frame> &frames, int max_error, int keyframe_interval) {
+    bench_result res;
+    std::vector<std::vector<uint8_t>> coded(frames.size());
+    static tc_encoder_t enc;
+    static tc_decoder_t dec;
+
+    // one pass to keep the output and check it, then timed passes
+    tc_encoder_init(&enc, keyframe_interval, max_error);
+    tc_decoder_init(&dec);
+    for (size_t i = 0; i < frames.size(); i++) {
+        uint8_t buf[TC_MAX_ENCODED];
+        int n = tc_encode(&enc, frames[i].data(), buf, sizeof(buf));
+        if (n < 0) throw std::runtime_error("encode failed");
+        coded[i].assign(buf, buf + n);
+        res.coded_bytes += n;
+        if (buf[0] & TC_FLAG_KEY) res.keyframes++;
+        if (buf[0] & TC_FLAG_RAW) res.raw_frames++;
+
+        thermal_frame out;
+        if (tc_decode(&dec, buf, n, out.data()) != TC_OK) throw std::runtime_error("decode failed");
+        for (int p = 0; p < TC_CELLS; p++) {
+            int err = std::abs(out[p] - frames[i][p]);
+            if (err > res.max_abs_error) res.max_abs_error = err;
+        }
+    }
+
+    double mb = frames.size() * TC_CELLS * sizeof(int16_t) / 1e6;
+    double enc_s = time_per_run([&] {
+        uint8_t buf[TC_MAX_ENCODED];
+        tc_encoder_init(&enc, keyframe_interval, max_error);
+        for (const auto &f : frames) tc_encode(&enc, f.data(), buf, sizeof(buf));
+    });
+    double dec_s = time_per_run([&] {
+        thermal_frame out;
+        tc_decoder_init(&dec);
+        for (const auto &c : coded) tc_decode(&dec, c.data(), c.size(), out.data());
+    });
+    res.encode_mb_s = mb / enc_s;
+    res.decode_mb_s = mb / dec_s;
+    return res;
+}
+
+static void usage() {
+    std::fprintf(stderr, "usage: codec_bench [-e max_error] [-k keyframe_interval] session.log ...\n"
+                         "       codec_bench [-e max_error] [-k keyframe_interval] --synthetic frames\n");
+    std::exit(2);
+}
+
+int main(int argc, char **argv) {
+    std::vector<int> max_errors;
+    int keyframe_interval = 8;
+    std::vector<std::string> files;
+    int synthetic = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "-e") && i + 1 < argc) {
+            max_errors.push_back(std::atoi(argv[++i]));
+        } else if (!std::strcmp(argv[i], "-k") && i + 1 < argc) {
+            keyframe_interval = std::atoi(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--synthetic") && i + 1 < argc) {
+            synthetic = std::atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            usage();
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty() && synthetic <= 0) usage();
+    if (max_errors.empty()) max_errors = {0, 1, 2};
+
+    std::vector<std::pair<std::string, std::vector<thermal_frame>>> sessions;
+    try {
+        for (const auto &f : files) sessions.emplace_back(f, load_session(f));
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    if (synthetic > 0) sessions.emplace_back("synthetic", synthetic_session(synthetic));
+
+    std::printf("%-24s %7s %5s %9s %9s %9s %9s %10s %10s\n", "session", "frames", "err", "B/frame",
+                "vs float", "vs int16", "max err", "enc MB/s", "dec MB/s");
+    for (const auto &s : sessions) {
+        if (s.second.empty()) {
+            std::printf("%-24s no frames found\n", s.first.c_str());
+            continue;
+        }
+        for (int e : max_errors) {
+            bench_result r = run(s.second, e, keyframe_interval);
+            double per_frame = (double)r.coded_bytes / s.second.size();
+            std::printf("%-24s %7zu %5.1f %9.1f %8.1fx %8.1fx %9.1f %10.1f %10.1f\n", s.first.c_str(),
+                        s.second.size(), e / 10.0, per_frame, TC_CELLS * sizeof(float) / per_frame,
+                        TC_CELLS * sizeof(int16_t) / per_frame, r.max_abs_error / 10.0, r.encode_mb_s,
+                        r.decode_mb_s);
+        }
+    }
+    return 0;
+}
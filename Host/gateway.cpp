@@ -0,0 +1,179 @@
+// Reads the reciever's binary host link (HOST_LINK_BINARY) and prints what comes in.
+//
+//   gateway /dev/ttyUSB0 [-b baud]      live, raw serial at 921600 unless -b says otherwise
+//   gateway capture.bin                  a saved capture of the same bytes
+//
+// Meant as a starting point for a real gateway: swap the printfs for whatever the alerts
+// and frames should go to. Link counters are printed at the end (Ctrl-C for live ports).
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include "link_decoder.h"
+
+static volatile sig_atomic_t stop = 0;
+
+static speed_t baud_constant(int baud) {
+    switch (baud) {
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+#ifdef B1500000
+        case 1500000: return B1500000;
+#endif
+#ifdef B2000000
+        case 2000000: return B2000000;
+#endif
+        default: throw std::runtime_error("unsupported baud rate " + std::to_string(baud));
+    }
+}
+
+// opens a serial port raw (8N1, no flow control) or any other file as is
+static int open_input(const std::string &path, int baud) {
+    int fd = open(path.c_str(), O_RDONLY | O_NOCTTY);
+    if (fd < 0) throw std::runtime_error("can't open " + path + ": " + std::strerror(errno));
+    if (!isatty(fd)) return fd;
+
+    termios tio;
+    if (tcgetattr(fd, &tio) != 0) throw std::runtime_error("tcgetattr failed on " + path);
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, baud_constant(baud));
+    cfsetospeed(&tio, baud_constant(baud));
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) throw std::runtime_error("tcsetattr failed on " + path);
+    return fd;
+}
+
+static void print_message(const hl_packet_t &from, const fp_header_t &h) {
+    const void *p = fp_payload(&h);
+    std::printf("n%02u [%u] ", from.node, h.seq);
+    switch (h.type) {
+        case FP_MSG_ALERT: {
+            const fp_alert_t *m = (const fp_alert_t *)p;
+            std::printf("%s at %.2f deg, peak %.1f, %upx, confidence %u%%\n", fp_state_name(m->level),
+                        m->bearing / 100.0, m->peak / 10.0, m->blob_px, m->confidence);
+            break;
+        }
+        case FP_MSG_STATUS: {
+            const fp_status_t *m = (const fp_status_t *)p;
+            std::printf("status %s, t_max %.1f at %.2f deg\n", fp_state_name(m->state), m->t_max / 10.0,
+                        m->t_max_bearing / 100.0);
+            break;
+        }
+        case FP_MSG_HEARTBEAT: {
+            const fp_heartbeat_t *m = (const fp_heartbeat_t *)p;
+            std::printf("heartbeat, up %us, %s\n", (unsigned)m->uptime_s, fp_state_name(m->state));
+            break;
+        }
+        case FP_MSG_TELEMETRY: {
+            const fp_telemetry_t *m = (const fp_telemetry_t *)p;
+            std::printf("telemetry, %u frames, %u ms/frame, %u tracks\n", (unsigned)m->frames, m->frame_ms,
+                        m->tracks);
+            break;
+        }
+        case FP_MSG_PERF: {
+            const fp_perf_t *m = (const fp_perf_t *)p;
+            int count = sizeof(fp_perf_t) + m->count * sizeof(fp_perf_entry_t) <= h.len ? m->count : 0;
+            std::printf("timing %u-%u of %u\n", m->first + 1, m->first + count, m->total);
+            for (int i = 0; i < count; i++) {
+                const fp_perf_entry_t &e = m->entries[i];
+                std::printf("    %-10.*s %6u, p50 <%.2fms p99 <%.2fms max %.2fms, %u over %.1fms\n",
+                            (int)sizeof(e.name), e.name, (unsigned)e.count, e.p50_us / 1000.0, e.p99_us / 1000.0,
+                            e.max_us / 1000.0, e.misses, e.deadline_us / 1000.0);
+            }
+            break;
+        }
+        case FP_MSG_POWER: {
+            const fp_power_t *m = (const fp_power_t *)p;
+            std::printf("power %s, %.1f mA full / %.1f mA sentinel (%s), avg %.1f mA, ~%u h on battery, "
+                        "%us full / %us sentinel, %u escalations\n",
+                        m->mode ? "SENTINEL" : "FULL", m->ma_full / 10.0, m->ma_sentinel / 10.0,
+                        m->measured ? "measured" : "estimated", m->ma_avg / 10.0, m->runtime_h,
+                        (unsigned)m->full_s, (unsigned)m->sentinel_s, m->escalations);
+            break;
+        }
+        default:
+            std::printf("type %u, %u bytes\n", h.type, h.len);
+            break;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string path;
+    int baud = HL_BAUD_DEFAULT;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "-b") && i + 1 < argc) {
+            baud = std::atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && path.empty()) {
+            path = argv[i];
+        } else {
+            std::fprintf(stderr, "usage: gateway [-b baud] /dev/ttyUSB0 | capture.bin\n");
+            return 2;
+        }
+    }
+    if (path.empty()) {
+        std::fprintf(stderr, "usage: gateway [-b baud] /dev/ttyUSB0 | capture.bin\n");
+        return 2;
+    }
+
+    gateway_handlers handlers;
+    handlers.on_message = print_message;
+    handlers.on_frame = [](const hl_frame_t &info, const thermal_frame &frame) {
+        int16_t hottest = frame[0];
+        for (int16_t v : frame) hottest = v > hottest ? v : hottest;
+        std::printf("n%02u FRAME %u at %.2f deg, %u bytes, max %.1f C\n", info.node, info.frame_id,
+                    info.bearing / 100.0, info.len, hottest / 10.0);
+    };
+    handlers.on_blackbox = [](const hl_packet_t &from, const fp_blackbox_t &m, const thermal_frame &frame) {
+        int16_t hottest = frame[0];
+        for (int16_t v : frame) hottest = v > hottest ? v : hottest;
+        std::printf("n%02u BLACKBOX #%u frame %u at %+.1fs, pos %d, %.2f deg, %d steps, %s, t_max %.1f, max %.1f C\n",
+                    from.node, m.incident, m.frame, m.t_ms / 1000.0, m.pos, m.bearing / 100.0, (int)m.motor_steps,
+                    fp_state_name(m.state), m.t_max / 10.0, hottest / 10.0);
+    };
+    handlers.on_node = [](const hl_node_t &ev) {
+        std::printf("n%02u %s after %.1fs, last state %s\n", ev.node, ev.online ? "back ONLINE" : "OFFLINE",
+                    ev.silent_ms / 1000.0, fp_state_name(ev.state));
+    };
+    handlers.on_text = [](const std::string &text) { std::fputs(text.c_str(), stdout); };
+    gateway gw(handlers);
+
+    int fd;
+    try {
+        fd = open_input(path, baud);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    std::signal(SIGINT, [](int) { stop = 1; });
+
+    uint8_t buf[4096];
+    while (!stop) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        gw.feed(buf, n);
+        std::fflush(stdout);
+    }
+    close(fd);
+
+    const link_stats &st = gw.stats();
+    std::fprintf(stderr, "%llu bytes, %llu messages, %llu lost, %llu crc errors, %llu framing errors, "
+                         "%llu frames waiting for a keyframe, %llu black box frames (%llu dropped)\n",
+                 (unsigned long long)st.bytes, (unsigned long long)st.messages, (unsigned long long)st.lost,
+                 (unsigned long long)st.crc_errors, (unsigned long long)st.framing_errors,
+                 (unsigned long long)gw.frames_undecodable(), (unsigned long long)gw.blackbox_frames(),
+                 (unsigned long long)gw.blackbox_dropped());
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include "link_decoder.h"
+
+#include <cstring>
+
+void link_decoder::feed(const uint8_t *data, size_t len) {
+    stats_.bytes += len;
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == HL_DELIMITER) {
+            finish_frame();
+        } else if (encoded_.size() < HL_MAX_ENCODED) {
+            encoded_.push_back(data[i]);
+        } else {
+            overflow_ = true;   // lost a delimiter somewhere, drop until the next one
+        }
+    }
+}
+
+void link_decoder::finish_frame() {
+    if (encoded_.empty() && !overflow_) return;     // back to back delimiters
+    int n = overflow_ ? -1 : hl_cobs_decode(encoded_.data(), encoded_.size(), decoded_.data(), decoded_.size());
+    encoded_.clear();
+    overflow_ = false;
+    if (n < HL_HEADER_BYTES + HL_CRC_BYTES) {
+        stats_.framing_errors++;
+        return;
+    }
+    size_t body_end = n - HL_CRC_BYTES;
+    uint16_t crc = decoded_[body_end] | (decoded_[body_end + 1] << 8);
+    if (fp_crc16(decoded_.data(), body_end) != crc) {
+        stats_.crc_errors++;
+        return;
+    }
+
+    link_message m;
+    m.type = decoded_[0];
+    m.seq = decoded_[1];
+    m.body.assign(decoded_.begin() + HL_HEADER_BYTES, decoded_.begin() + body_end);
+    if (have_seq_ && m.seq != next_seq_) stats_.lost += (uint8_t)(m.seq - next_seq_);
+    have_seq_ = true;
+    next_seq_ = m.seq + 1;
+    stats_.messages++;
+    on_message_(m);
+}
+
+gateway::gateway(gateway_handlers handlers)
+    : handlers_(std::move(handlers)), link_([this](const link_message &m) { dispatch(m); }) {}
+
+void gateway::dispatch(const link_message &m) {
+    switch (m.type) {
+        case HL_MSG_PACKET:
+            handle_packet(m.body.data(), m.body.size());
+            break;
+        case HL_MSG_FRAME:
+            handle_frame(m.body.data(), m.body.size());
+            break;
+        case HL_MSG_NODE:
+            if (m.body.size() >= sizeof(hl_node_t) && handlers_.on_node) {
+                hl_node_t ev;
+                std::memcpy(&ev, m.body.data(), sizeof(ev));
+                handlers_.on_node(ev);
+            }
+            break;
+        case HL_MSG_TEXT:
+            if (handlers_.on_text) handlers_.on_text(std::string(m.body.begin(), m.body.end()));
+            break;
+        default:
+            break;      // newer reciever, skip what we don't know
+    }
+}
+
+// hands the radio message on, a batch as one call per record with the batch's seq
+void gateway::handle_packet(const uint8_t *body, size_t len) {
+    if (len < sizeof(hl_packet_t) || !handlers_.on_message) return;
+    hl_packet_t from;
+    std::memcpy(&from, body, sizeof(from));
+    const fp_header_t *h = fp_parse(body + sizeof(from), (int)(len - sizeof(from)));
+    if (h == nullptr) return;
+    if (h->type == FP_MSG_BLACKBOX) {
+        handle_blackbox(from, *h);
+        return;
+    }
+    if (h->type != FP_MSG_BATCH) {
+        handlers_.on_message(from, *h);
+        return;
+    }
+    uint8_t one[FP_MAX_PACKET];
+    size_t offset = 0;
+    const fp_record_t *r;
+    while ((r = fp_next_record(h, &offset)) != nullptr) {
+        fp_init_header((fp_header_t *)one, r->type, h->seq, r->len);
+        std::memcpy(one + sizeof(fp_header_t), r->data, r->len);
+        handlers_.on_message(from, *(const fp_header_t *)one);
+    }
+}
+
+void gateway::handle_frame(const uint8_t *body, size_t len) {
+    if (len < sizeof(hl_frame_t)) return;
+    hl_frame_t info;
+    std::memcpy(&info, body, sizeof(info));
+    if (sizeof(info) + info.len > len) return;
+
+    auto it = decoders_.find(info.node);
+    if (it == decoders_.end()) {
+        it = decoders_.emplace(info.node, tc_decoder_t{}).first;
+        tc_decoder_init(&it->second);
+    }
+    thermal_frame frame;
+    if (tc_decode(&it->second, body + sizeof(info), info.len, frame.data()) != TC_OK) {
+        frames_undecodable_++;  // usually a lost frame before this delta, waits for a keyframe
+        return;
+    }
+    if (handlers_.on_frame) handlers_.on_frame(info, frame);
+}
+
+// collects one black box fragment, decodes and hands on the frame once all of them are in
+void gateway::handle_blackbox(const hl_packet_t &from, const fp_header_t &h) {
+    if (h.len < sizeof(fp_blackbox_t)) {
+        blackbox_dropped_++;
+        return;
+    }
+    const fp_blackbox_t *m = (const fp_blackbox_t *)fp_payload(&h);
+    size_t first = m->index * FP_BLACKBOX_MAX_DATA;
+    size_t n = h.len - sizeof(fp_blackbox_t);
+    if (fp_blackbox_crc(m, h.len) != m->crc || m->count == 0 || m->count > 31 || m->index >= m->count ||
+        (m->index < m->count - 1 && n != FP_BLACKBOX_MAX_DATA) || first + n > TC_MAX_ENCODED) {
+        blackbox_dropped_++;
+        return;
+    }
+    blackbox_key key{from.node, m->incident, m->frame};
+    auto done = blackbox_done_.find(from.node);
+    if (done != blackbox_done_.end() && done->second == key) return;     // late resend
+
+    auto it = blackbox_partial_.find(key);
+    if (it == blackbox_partial_.end()) {
+        if (blackbox_partial_.size() >= blackbox_max_partial) {
+            auto oldest = blackbox_partial_.begin();
+            for (auto p = blackbox_partial_.begin(); p != blackbox_partial_.end(); ++p) {
+                if (p->second.order < oldest->second.order) oldest = p;
+            }
+            blackbox_partial_.erase(oldest);
+            blackbox_dropped_++;
+        }
+        it = blackbox_partial_.emplace(key, blackbox_partial{}).first;
+        it->second.count = m->count;
+        it->second.order = blackbox_order_++;
+    }
+    blackbox_partial &part = it->second;
+    if (m->count != part.count) {
+        blackbox_dropped_++;
+        return;
+    }
+    std::memcpy(part.data.data() + first, m->data, n);
+    part.have |= 1UL << m->index;
+    if (m->index == m->count - 1) part.len = first + n;
+    if (part.have != (1UL << part.count) - 1) return;
+
+    tc_decoder_t dec;
+    tc_decoder_init(&dec);
+    thermal_frame frame;
+    int err = tc_decode(&dec, part.data.data(), part.len, frame.data());
+    blackbox_partial_.erase(it);
+    blackbox_done_[from.node] = key;
+    if (err != TC_OK) {
+        blackbox_dropped_++;
+        return;
+    }
+    blackbox_frames_++;
+    if (handlers_.on_blackbox) handlers_.on_blackbox(from, *m, frame);
+}
@@ -0,0 +1,109 @@
+#ifndef LINK_DECODER_H
+#define LINK_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "host_link.h"
+#include "session.h"
+
+// Host side of the reciever's binary link (Common/host_link.h).
+//
+// link_decoder splits the raw serial byte stream into checked messages: bytes are collected
+// up to each 0x00, COBS decoded and CRC checked. Anything broken is counted and skipped, the
+// next 0x00 always starts clean, so the decoder can be started mid-stream.
+//
+// gateway sits on top and hands out what a host application wants: every radio message
+// (batches already split into their records), decoded thermal frames, decoded black box
+// frames and node events. Black box fragments are put back together per (node, incident,
+// frame), CRC checked, and each frame (always a keyframe) decoded with a fresh tc_decoder_t.
+
+struct link_message {
+    uint8_t type;               // hl_type_t
+    uint8_t seq;
+    std::vector<uint8_t> body;
+};
+
+struct link_stats {
+    uint64_t bytes = 0;
+    uint64_t messages = 0;
+    uint64_t crc_errors = 0;
+    uint64_t framing_errors = 0;    // bad COBS, too short or too long
+    uint64_t lost = 0;              // messages missing going by seq
+};
+
+class link_decoder {
+public:
+    using handler = std::function<void(const link_message &)>;
+
+    explicit link_decoder(handler on_message) : on_message_(std::move(on_message)) {}
+
+    // call with whatever the port returned, in any sized pieces
+    void feed(const uint8_t *data, size_t len);
+    const link_stats &stats() const { return stats_; }
+
+private:
+    void finish_frame();
+
+    handler on_message_;
+    std::vector<uint8_t> encoded_;
+    std::vector<uint8_t> decoded_ = std::vector<uint8_t>(HL_MAX_RAW);
+    bool overflow_ = false;
+    bool have_seq_ = false;
+    uint8_t next_seq_ = 0;
+    link_stats stats_;
+};
+
+struct gateway_handlers {
+    // one radio message; h points into a buffer that's only valid during the call
+    std::function<void(const hl_packet_t &from, const fp_header_t &h)> on_message;
+    std::function<void(const hl_frame_t &info, const thermal_frame &frame)> on_frame;
+    // meta is the fragment that completed the frame; time, position and state are in all of them
+    std::function<void(const hl_packet_t &from, const fp_blackbox_t &meta, const thermal_frame &frame)> on_blackbox;
+    std::function<void(const hl_node_t &event)> on_node;
+    std::function<void(const std::string &text)> on_text;
+};
+
+class gateway {
+public:
+    explicit gateway(gateway_handlers handlers);
+
+    void feed(const uint8_t *data, size_t len) { link_.feed(data, len); }
+    const link_stats &stats() const { return link_.stats(); }
+    uint64_t frames_undecodable() const { return frames_undecodable_; }
+    uint64_t blackbox_frames() const { return blackbox_frames_; }
+    uint64_t blackbox_dropped() const { return blackbox_dropped_; }
+
+private:
+    // a black box frame whose fragments are still coming in
+    struct blackbox_partial {
+        uint8_t count = 0;
+        uint32_t have = 0;          // bit i set once fragment i arrived
+        size_t len = 0;             // known once the last fragment is in
+        uint64_t order = 0;         // when it was started, the oldest goes first
+        std::vector<uint8_t> data = std::vector<uint8_t>(TC_MAX_ENCODED);
+    };
+    using blackbox_key = std::tuple<int, int, int>;     // node, incident, frame
+    static constexpr size_t blackbox_max_partial = 8;
+
+    void dispatch(const link_message &m);
+    void handle_packet(const uint8_t *body, size_t len);
+    void handle_frame(const uint8_t *body, size_t len);
+    void handle_blackbox(const hl_packet_t &from, const fp_header_t &h);
+
+    gateway_handlers handlers_;
+    link_decoder link_;
+    std::map<int, tc_decoder_t> decoders_;  // per node, delta frames refer to its last frame
+    uint64_t frames_undecodable_ = 0;
+    std::map<blackbox_key, blackbox_partial> blackbox_partial_;
+    std::map<int, blackbox_key> blackbox_done_;     // per node, last completed, to ignore late resends
+    uint64_t blackbox_order_ = 0;
+    uint64_t blackbox_frames_ = 0;
+    uint64_t blackbox_dropped_ = 0;     // bad crc, bad fragment, never completed or didn't decode
+};
+
+#endif // LINK_DECODER_H
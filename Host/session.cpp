@@ -0,0 +1,73 @@
+#include "session.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+// parses "25.1,25.3,...," into values, returns false unless it's exactly TC_COLS numbers
+static bool parse_row(const std::string &line, float *row) {
+    const char *p = line.c_str();
+    int n = 0;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        if (!*p || *p == '\r' || *p == '\n') break;
+        char *end;
+        float v = std::strtof(p, &end);
+        if (end == p || n == TC_COLS) return false;
+        row[n++] = v;
+        p = end;
+    }
+    return n == TC_COLS;
+}
+
+std::vector<thermal_frame> load_session(const std::string &path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("can't open " + path);
+
+    std::vector<thermal_frame> frames;
+    float image[TC_CELLS];
+    int rows = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!parse_row(line, &image[rows * TC_COLS])) {
+            rows = 0;   // a frame is only good if its rows are back to back
+            continue;
+        }
+        if (++rows == TC_ROWS) {
+            thermal_frame f;
+            tc_quantize(image, f.data());
+            frames.push_back(f);
+            rows = 0;
+        }
+    }
+    return frames;
+}
+
+std::vector<thermal_frame> synthetic_session(int frames, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> noise(0.0f, 0.15f);     // roughly the MLX90640 at 2 Hz
+    std::vector<thermal_frame> out;
+    float image[TC_CELLS];
+
+    for (int f = 0; f < frames; f++) {
+        float cx = 4.0f + std::fmod(f * 0.15f, 24.0f);
+        float cy = 12.0f + 3.0f * std::sin(f * 0.05f);
+        float radius = 1.5f + f * 0.01f;
+        float peak = 60.0f + f * 0.2f;
+        for (int r = 0; r < TC_ROWS; r++) {
+            for (int c = 0; c < TC_COLS; c++) {
+                float d2 = (c - cx) * (c - cx) + (r - cy) * (r - cy);
+                float t = 24.0f + 0.04f * r;                        // warmer towards the floor
+                t += peak * std::exp(-d2 / (2.0f * radius * radius));
+                image[r * TC_COLS + c] = t + noise(rng);
+            }
+        }
+        thermal_frame q;
+        tc_quantize(image, q.data());
+        out.push_back(q);
+    }
+    return out;
+}
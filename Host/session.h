@@ -0,0 +1,23 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "thermal_codec.h"
+
+// One 32x24 frame in tenths of a degree C, row-major, same as the codec works on.
+using thermal_frame = std::array<int16_t, TC_CELLS>;
+
+// Reads a recorded session: a serial capture from the reciever (FRAME lines, each followed
+// by 24 rows of comma separated temperatures) or from the detector's own temperature dump.
+// Any line with exactly 32 numbers counts as a row, 24 rows in a row make a frame, other
+// lines are skipped. Throws std::runtime_error if the file can't be opened.
+std::vector<thermal_frame> load_session(const std::string &path);
+
+// Made-up session for when there's no recording at hand: a room at ~24 C with sensor noise
+// and a hot spot that drifts across the view and slowly grows. Deterministic for a seed.
+std::vector<thermal_frame> synthetic_session(int frames, unsigned seed = 1);
+
+#endif // SESSION_H
@@ -0,0 +1,107 @@
+#include <string.h>
+#include "node_table.h"
+#include "blackbox_reassembly.h"
+
+typedef struct {
+    bool used;
+    uint8_t count;              // fragments expected
+    uint32_t have;              // bit i set once fragment i arrived
+    uint16_t len;               // known once the last fragment is in
+    int64_t started_us;
+    blackbox_frame_t frame;
+} slot_t;
+
+static slot_t slots[BLACKBOX_SLOTS];
+static blackbox_frame_t done;   // last completed frame, handed out by blackbox_reassembly_add
+static uint16_t last_done[NODE_TABLE_SIZE];     // incident << 8 | frame
+static bool have_done[NODE_TABLE_SIZE];
+static blackbox_stats_t stats;
+
+void blackbox_reassembly_init(void) {
+    memset(slots, 0, sizeof(slots));
+    memset(&stats, 0, sizeof(stats));
+    memset(have_done, 0, sizeof(have_done));
+}
+
+// slot already collecting this frame, else a free one, else the oldest (which is dropped)
+static slot_t *find_slot(int node, uint8_t incident, uint8_t frame, int64_t now_us) {
+    slot_t *free_slot = NULL, *oldest = NULL;
+    for (int i = 0; i < BLACKBOX_SLOTS; i++) {
+        slot_t *s = &slots[i];
+        if (s->used && now_us - s->started_us > BLACKBOX_TIMEOUT_US) {
+            s->used = false;
+            stats.incomplete++;
+        }
+        if (s->used && s->frame.node == node && s->frame.incident == incident && s->frame.frame == frame) return s;
+        if (!s->used && !free_slot) free_slot = s;
+        if (s->used && (!oldest || s->started_us < oldest->started_us)) oldest = s;
+    }
+    if (free_slot) return free_slot;
+    stats.incomplete++;
+    oldest->used = false;
+    return oldest;
+}
+
+// Adds one fragment (len = payload bytes) from the given sender. Returns the finished frame
+// when this fragment completed one, otherwise NULL. The frame stays valid until the next
+// completed frame; its time, position and so on are in any of its fragments, e.g. this one.
+const blackbox_frame_t *blackbox_reassembly_add(int node, const fp_blackbox_t *frag, size_t len, int64_t now_us) {
+    int first = frag->index * FP_BLACKBOX_MAX_DATA;
+    int n = len - sizeof(fp_blackbox_t);
+
+    if (len < sizeof(fp_blackbox_t)) {
+        stats.bad_fragment++;
+        return NULL;
+    }
+    if (fp_blackbox_crc(frag, len) != frag->crc) {
+        stats.bad_crc++;
+        return NULL;
+    }
+    // every fragment but the last is full, and the whole thing has to fit in a frame
+    if (frag->count == 0 || frag->count > BLACKBOX_MAX_FRAGS || frag->index >= frag->count ||
+        (frag->index < frag->count - 1 && n != (int)FP_BLACKBOX_MAX_DATA) || first + n > TC_MAX_ENCODED) {
+        stats.bad_fragment++;
+        return NULL;
+    }
+
+    bool known = node >= 0 && node < NODE_TABLE_SIZE;
+    uint16_t id = frag->incident << 8 | frag->frame;
+    if (known && have_done[node] && last_done[node] == id) {
+        stats.late++;
+        return NULL;
+    }
+
+    slot_t *s = find_slot(node, frag->incident, frag->frame, now_us);
+    if (!s->used) {
+        s->used = true;
+        s->count = frag->count;
+        s->have = 0;
+        s->len = 0;
+        s->started_us = now_us;
+        s->frame.node = node;
+        s->frame.incident = frag->incident;
+        s->frame.frame = frag->frame;
+    }
+    if (frag->count != s->count) {
+        stats.bad_fragment++;
+        return NULL;
+    }
+    memcpy(&s->frame.data[first], frag->data, n);
+    s->have |= 1UL << frag->index;
+    if (frag->index == frag->count - 1) s->len = first + n;
+
+    if (s->have != (1UL << s->count) - 1) return NULL;
+    s->frame.len = s->len;
+    memcpy(&done, &s->frame, sizeof(done));
+    s->used = false;
+    stats.completed++;
+    if (known) {
+        last_done[node] = id;
+        have_done[node] = true;
+    }
+    return &done;
+}
+
+void blackbox_reassembly_stats(blackbox_stats_t *out) {
+    *out = stats;
+}
@@ -0,0 +1,39 @@
+#ifndef BLACKBOX_REASSEMBLY_H
+#define BLACKBOX_REASSEMBLY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fire_protocol.h"
+#include "thermal_codec.h"
+
+// Puts FP_MSG_BLACKBOX fragments back together into whole coded frames, keyed by node,
+// incident and frame -- frame_reassembly.c does the same for the live stream. A dump sends
+// its frames one after the other, so a couple of slots are plenty; a frame that is still
+// missing pieces when its slot is needed (or after BLACKBOX_TIMEOUT_US) is thrown away.
+// Every black box frame is a keyframe, so it decodes with a fresh tc_decoder_t.
+#define BLACKBOX_SLOTS 2
+#define BLACKBOX_TIMEOUT_US 5000000     // dumps are paced at 10 fragments a second
+#define BLACKBOX_MAX_FRAGS 31           // per frame, one bit each in a slot's mask
+
+typedef struct {
+    int node;                   // node_table index of the sender
+    uint8_t incident;
+    uint8_t frame;
+    uint16_t len;               // coded bytes
+    uint8_t data[TC_MAX_ENCODED];   // one thermal_codec keyframe
+} blackbox_frame_t;
+
+typedef struct {
+    uint32_t completed;
+    uint32_t incomplete;        // dropped with fragments missing
+    uint32_t bad_crc;
+    uint32_t bad_fragment;      // index/count/length that makes no sense
+    uint32_t late;              // fragments of a frame that was already complete
+} blackbox_stats_t;
+
+// Function Declarations
+void blackbox_reassembly_init(void);
+const blackbox_frame_t *blackbox_reassembly_add(int node, const fp_blackbox_t *frag, size_t len, int64_t now_us);
+void blackbox_reassembly_stats(blackbox_stats_t *stats);
+
+#endif // BLACKBOX_REASSEMBLY_H
@@ -0,0 +1,102 @@
+#include <string.h>
+#include "node_table.h"
+#include "frame_reassembly.h"
+
+typedef struct {
+    bool used;
+    uint8_t count;              // fragments expected
+    uint32_t have;              // bit i set once fragment i arrived
+    uint16_t len;               // known once the last fragment is in
+    int64_t started_us;
+    frame_t frame;
+} slot_t;
+
+static slot_t slots[FRAME_SLOTS];
+static frame_t done;            // last completed frame, handed out by frame_reassembly_add
+static uint16_t last_done_id[NODE_TABLE_SIZE];
+static bool have_done[NODE_TABLE_SIZE];
+static frame_stats_t stats;
+
+void frame_reassembly_init(void) {
+    memset(slots, 0, sizeof(slots));
+    memset(&stats, 0, sizeof(stats));
+    memset(have_done, 0, sizeof(have_done));
+}
+
+// slot already collecting this frame, else a free one, else the oldest (which is dropped)
+static slot_t *find_slot(int node, uint16_t frame_id, int64_t now_us) {
+    slot_t *free_slot = NULL, *oldest = NULL;
+    for (int i = 0; i < FRAME_SLOTS; i++) {
+        slot_t *s = &slots[i];
+        if (s->used && now_us - s->started_us > FRAME_TIMEOUT_US) {
+            s->used = false;
+            stats.incomplete++;
+        }
+        if (s->used && s->frame.node == node && s->frame.frame_id == frame_id) return s;
+        if (!s->used && !free_slot) free_slot = s;
+        if (s->used && (!oldest || s->started_us < oldest->started_us)) oldest = s;
+    }
+    if (free_slot) return free_slot;
+    stats.incomplete++;
+    oldest->used = false;
+    return oldest;
+}
+
+// Adds one fragment (len = payload bytes) from the given sender. Returns the finished frame
+// when this fragment completed one, otherwise NULL. The frame stays valid until the next
+// completed frame.
+const frame_t *frame_reassembly_add(int node, const fp_frag_t *frag, size_t len, int64_t now_us) {
+    int first = frag->index * FP_FRAG_MAX_DATA;
+    int n = len - sizeof(fp_frag_t);
+
+    if (fp_frag_crc(frag, len) != frag->crc) {
+        stats.bad_crc++;
+        return NULL;
+    }
+    // every fragment but the last is full, and the whole thing has to fit in a frame_t
+    if (frag->count == 0 || frag->count > FP_FRAG_MAX_COUNT || frag->index >= frag->count ||
+        (frag->index < frag->count - 1 && n != FP_FRAG_MAX_DATA) || first + n > TC_MAX_ENCODED) {
+        stats.bad_fragment++;
+        return NULL;
+    }
+
+    bool known = node >= 0 && node < NODE_TABLE_SIZE;
+    if (known && have_done[node] && last_done_id[node] == frag->frame_id) {
+        stats.late++;
+        return NULL;
+    }
+
+    slot_t *s = find_slot(node, frag->frame_id, now_us);
+    if (!s->used) {
+        s->frame.node = node;
+        s->used = true;
+        s->count = frag->count;
+        s->have = 0;
+        s->len = 0;
+        s->started_us = now_us;
+        s->frame.frame_id = frag->frame_id;
+    }
+    if (frag->count != s->count) {
+        stats.bad_fragment++;
+        return NULL;
+    }
+    s->frame.bearing = frag->bearing;
+    memcpy(&s->frame.data[first], frag->data, n);
+    s->have |= 1UL << frag->index;
+    if (frag->index == frag->count - 1) s->len = first + n;
+
+    if (s->have != (1UL << s->count) - 1) return NULL;
+    s->frame.len = s->len;
+    memcpy(&done, &s->frame, sizeof(done));
+    s->used = false;
+    stats.completed++;
+    if (known) {
+        last_done_id[node] = done.frame_id;
+        have_done[node] = true;
+    }
+    return &done;
+}
+
+void frame_reassembly_stats(frame_stats_t *out) {
+    *out = stats;
+}
@@ -0,0 +1,39 @@
+#ifndef FRAME_REASSEMBLY_H
+#define FRAME_REASSEMBLY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fire_protocol.h"
+#include "thermal_codec.h"
+
+// Puts FP_MSG_FRAME_FRAG fragments back together into whole coded frames.
+// A fixed pool of slots holds frames in progress, fragments can arrive in any order and
+// duplicates are harmless. A frame that is still missing pieces when its slot is needed
+// (or after FRAME_TIMEOUT_US) is thrown away. The last completed frame id of each node is
+// remembered, so a late resend of one of its fragments doesn't open a slot that would never
+// fill up and push out frames still in progress.
+#define FRAME_SLOTS 4
+#define FRAME_TIMEOUT_US 2000000    // 2 s, a few sensor frames
+
+typedef struct {
+    int node;                   // node_table index of the sender
+    uint16_t frame_id;
+    uint16_t bearing;           // hundredths of a degree
+    uint16_t len;               // coded bytes
+    uint8_t data[TC_MAX_ENCODED];   // one thermal_codec frame, see tc_decode
+} frame_t;
+
+typedef struct {
+    uint32_t completed;
+    uint32_t incomplete;        // dropped with fragments missing
+    uint32_t bad_crc;
+    uint32_t bad_fragment;      // index/count/length that makes no sense
+    uint32_t late;              // fragments of a frame that was already complete
+} frame_stats_t;
+
+// Function Declarations
+void frame_reassembly_init(void);
+const frame_t *frame_reassembly_add(int node, const fp_frag_t *frag, size_t len, int64_t now_us);
+void frame_reassembly_stats(frame_stats_t *stats);
+
+#endif // FRAME_REASSEMBLY_H
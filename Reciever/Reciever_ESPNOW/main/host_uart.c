@@ -0,0 +1,48 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "driver/uart.h"
+#include "host_uart.h"
+
+static SemaphoreHandle_t lock;
+static uint8_t raw[HL_MAX_RAW];
+static uint8_t encoded[HL_MAX_ENCODED];
+static uint8_t seq = 0;
+static uint32_t sent = 0;
+static uint32_t dropped = 0;           // too big to frame
+
+void host_uart_init(void) {
+    lock = xSemaphoreCreateMutex();
+}
+
+// Sends one link message: head and body are just concatenated, so callers can put a small
+// struct in front of a packet or frame without copying it together first.
+void host_uart_send(uint8_t type, const void *head, size_t head_len, const void *body, size_t body_len) {
+    if (head_len + body_len > HL_MAX_BODY) {
+        dropped++;
+        return;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    size_t n = 0;
+    raw[n++] = type;
+    raw[n++] = seq++;
+    if (head_len) memcpy(raw + n, head, head_len);
+    n += head_len;
+    if (body_len) memcpy(raw + n, body, body_len);
+    n += body_len;
+    uint16_t crc = fp_crc16(raw, n);
+    raw[n++] = (uint8_t)crc;
+    raw[n++] = (uint8_t)(crc >> 8);
+
+    encoded[0] = HL_DELIMITER;
+    size_t len = 1 + hl_cobs_encode(raw, n, encoded + 1);
+    encoded[len++] = HL_DELIMITER;
+    uart_write_bytes(UART_NUM_0, encoded, len);
+    sent++;
+    xSemaphoreGive(lock);
+}
+
+void host_uart_get_stats(uint32_t *sent_out, uint32_t *dropped_out) {
+    *sent_out = sent;
+    *dropped_out = dropped;
+}
@@ -0,0 +1,17 @@
+#ifndef HOST_UART_H
+#define HOST_UART_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "host_link.h"
+
+// Reciever side of the binary host link (Common/host_link.h): frames messages and writes
+// them to the UART. Safe to call from the rx worker and the console task at the same time.
+#define HOST_UART_TX_BUFFER 4096    // a couple of whole frames, so the worker rarely waits
+
+// Function Declarations
+void host_uart_init(void);
+void host_uart_send(uint8_t type, const void *head, size_t head_len, const void *body, size_t body_len);
+void host_uart_get_stats(uint32_t *sent, uint32_t *dropped);
+
+#endif // HOST_UART_H
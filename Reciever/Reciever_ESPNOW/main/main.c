@@ -6,21 +6,464 @@
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "fire_protocol.h"
+#include "frame_reassembly.h"
+#include "blackbox_reassembly.h"
+#include "rx_ring.h"
+#include "node_table.h"
+#include "timer_wheel.h"
+#include "host_uart.h"
 
 //Reciever CODE (GREEN ESP)
 // MAC ADDR:  08:D1:F9:DD:54:3C
 
 static const char *TAG = "ESP-NOW SLAVE";
+// requests go out as broadcasts so the reciever doesn't need to know the detector's MAC
+static const uint8_t broadcast_mac[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+static uint16_t tx_seq = 0;            // starts somewhere random, see app_main
+
+// frames from different detectors need their own decoder (deltas refer to that detector's
+// last frame), but at 3 KB each there's only room for a few; they go to whoever streamed
+// most recently
+#define FRAME_DECODERS 4
+typedef struct {
+    int node;                   // node_table index, -1 = free
+    int64_t last_used_us;
+    tc_decoder_t dec;
+} frame_decoder_t;
+static frame_decoder_t decoders[FRAME_DECODERS];
+
+// at most one status line per node per this long, unless its state changed
+#define STATUS_PRINT_MS 900
+static int64_t last_status_print_us[NODE_TABLE_SIZE];
+
+// uncomment to talk to a host gateway in binary (Common/host_link.h, decoder in Host/)
+// instead of printing text: every accepted message, whole coded frames and node events,
+// COBS framed with a CRC. The console keys still work.
+//#define HOST_LINK_BINARY
+#define HOST_LINK_BAUD HL_BAUD_DEFAULT
+
+// a detector is reported offline after this many of its heartbeat periods without hearing
+// anything from it at all; nodes that haven't sent a heartbeat yet get the default period
+#define LIVENESS_MISSED_BEATS 3
+#define LIVENESS_DEFAULT_PERIOD_S 5
+static tw_wheel_t liveness_wheel;      // only touched by rx_worker
+
+// packets go from the wifi callback into rx_ring and are handled by rx_worker
+#define RX_WORKER_PRIORITY 5
+#define RX_WORKER_STACK 4096
+static rx_ring_t rx_ring;
+static TaskHandle_t rx_worker_handle;
+
+static uint32_t rx_invalid = 0;
+static float rx_rate = 0;           // packets/s into the ring, updated about once a second
 
 void print_msg(char* message){
+    #ifdef HOST_LINK_BINARY
+    host_uart_send(HL_MSG_TEXT, message, strlen(message), NULL, 0);
+    #else
     uart_write_bytes(UART_NUM_0, message, strlen(message));
+    #endif
 }
 
-// Callback function when data is received
-void on_data_recv(const esp_now_recv_info_t *info, const uint8_t *data, int len) {
-    char * message = (char*)data;
+// turns one protocol message into a line of text, returns the length
+static int format_message(const fp_header_t *h, char *out, size_t size) {
+    const void *p = fp_payload(h);
+    int n = 0;
+    switch (h->type) {
+        case FP_MSG_STATUS: {
+            const fp_status_t *m = p;
+            n = snprintf(out, size, "[%u] %s: pos %d t_max=%.1f at %.2f deg t_min=%.1f ta=%.1f\n", h->seq,
+                         fp_state_name(m->state), m->pos, m->t_max / 10.0f, m->t_max_bearing / 100.0f,
+                         m->t_min / 10.0f, m->ta / 10.0f);
+            break;
+        }
+        case FP_MSG_ALERT: {
+            const fp_alert_t *m = p;
+            n = snprintf(out, size, "[%u] %s DETECTED at %.2f deg: peak=%.1f size=%upx confidence=%u%% track=%u\n",
+                         h->seq, fp_state_name(m->level), m->bearing / 100.0f, m->peak / 10.0f, m->blob_px,
+                         m->confidence, m->track_id);
+            break;
+        }
+        case FP_MSG_HEARTBEAT: {
+            const fp_heartbeat_t *m = p;
+            n = snprintf(out, size, "[%u] heartbeat: up %lus, %s, next within %us\n", h->seq,
+                         (unsigned long)m->uptime_s, fp_state_name(m->state), m->period_s);
+            break;
+        }
+        case FP_MSG_TELEMETRY: {
+            const fp_telemetry_t *m = p;
+            n = snprintf(out, size, "[%u] telemetry: %lu frames, %ums/frame, %u/48 tiles, %u tracks, %u tx fails, ta=%.1f\n",
+                         h->seq, (unsigned long)m->frames, m->frame_ms, m->tiles_calc, m->tracks, m->tx_fail,
+                         m->ta / 10.0f);
+            break;
+        }
+        case FP_MSG_LINK: {
+            const fp_link_t *m = p;
+            n = snprintf(out, size, "[%u] link: %lu delivered, %u retries, %u gave up, %u dropped, alerts p99 %ums max %ums, "
+                         "routine p99 %ums max %ums, queue: %u dropped, high water %u, %u status coalesced\n",
+                         h->seq, (unsigned long)m->delivered, m->retries, m->gave_up, m->dropped,
+                         m->alert_p99_ms, m->alert_max_ms, m->latency_p99_ms, m->latency_max_ms,
+                         m->queue_dropped, m->queue_high_water,
+                         m->status_coalesced);
+            break;
+        }
+        case FP_MSG_RELAY_STATS: {
+            const fp_relay_stats_t *m = p;
+            n = snprintf(out, size, "[%u] relay: %lu forwarded, %u duplicates, %u ttl expired, %u queue full, "
+                         "avg %.1fms max %.1fms per hop\n",
+                         h->seq, (unsigned long)m->forwarded, m->duplicates, m->ttl_expired, m->queue_full,
+                         m->latency_avg_100us / 10.0f, m->latency_max_100us / 10.0f);
+            break;
+        }
+        case FP_MSG_SCAN_STATS: {
+            // pos: risk, revisit target / last / worst
+            const fp_scan_stats_t *m = p;
+            int count = m->positions < FP_SCAN_MAX_POSITIONS ? m->positions : FP_SCAN_MAX_POSITIONS;
+            n = snprintf(out, size, "[%u] scan:", h->seq);
+            for (int i = 0; i < count && n < (int)size; i++) {
+                n += snprintf(out + n, size - n, " %+d: %u%% %.1f/%.1f/%.1fs", m->first_pos + i, m->risk_pct[i],
+                              m->target_ds[i] / 10.0f, m->last_revisit_ds[i] / 10.0f, m->worst_revisit_ds[i] / 10.0f);
+            }
+            if (n < (int)size) n += snprintf(out + n, size - n, "\n");
+            break;
+        }
+        case FP_MSG_PERF: {
+            const fp_perf_t *m = p;
+            int count = m->count;
+            if (sizeof(fp_perf_t) + count * sizeof(fp_perf_entry_t) > h->len) count = 0;
+            n = snprintf(out, size, "[%u] timing %u-%u of %u:\n", h->seq, m->first + 1, m->first + count, m->total);
+            for (int i = 0; i < count && n < (int)size; i++) {
+                const fp_perf_entry_t *e = &m->entries[i];
+                n += snprintf(out + n, size - n, "  %-10.*s %6lu, p50 <%.2fms p99 <%.2fms max %.2fms, %u over %.1fms\n",
+                              (int)sizeof(e->name), e->name, (unsigned long)e->count, e->p50_us / 1000.0f,
+                              e->p99_us / 1000.0f, e->max_us / 1000.0f, e->misses, e->deadline_us / 1000.0f);
+            }
+            break;
+        }
+        case FP_MSG_POWER: {
+            const fp_power_t *m = p;
+            n = snprintf(out, size, "[%u] power: %s, %.1f mA full / %.1f mA sentinel (%s), avg %.1f mA, "
+                         "~%u h on battery, %lus full / %lus sentinel, %u escalations\n",
+                         h->seq, m->mode ? "SENTINEL" : "FULL", m->ma_full / 10.0f, m->ma_sentinel / 10.0f,
+                         m->measured ? "measured" : "estimated", m->ma_avg / 10.0f, m->runtime_h,
+                         (unsigned long)m->full_s, (unsigned long)m->sentinel_s, m->escalations);
+            break;
+        }
+        case FP_MSG_BATCH: {
+            // each record is formatted as if it had come in its own packet
+            uint8_t one[FP_MAX_PACKET];
+            size_t offset = 0;
+            const fp_record_t *r;
+            while ((r = fp_next_record(h, &offset)) != NULL && n < (int)size - 1) {
+                fp_init_header((fp_header_t *)one, r->type, h->seq, r->len);
+                memcpy(one + sizeof(fp_header_t), r->data, r->len);
+                n += format_message((const fp_header_t *)one, out + n, size - n);
+            }
+            break;
+        }
+        case FP_MSG_TEXT:
+            n = snprintf(out, size, "%.*s", h->len, (const char *)p);
+            break;
+        case FP_MSG_PANO: {
+            const fp_pano_t *m = p;
+            int count = m->count;
+            if (sizeof(fp_pano_t) + count * sizeof(int16_t) > h->len) count = 0;
+            n = snprintf(out, size, "PANO %u %u:", m->row, m->col);
+            for (int i = 0; i < count && n < (int)size; i++) {
+                int16_t v = m->cells[i];
+                if (v == FP_PANO_UNSEEN) {
+                    n += snprintf(out + n, size - n, "-,");
+                } else {
+                    n += snprintf(out + n, size - n, "%.1f,", v / 10.0f);
+                }
+            }
+            if (n < (int)size) n += snprintf(out + n, size - n, "\n");
+            break;
+        }
+        default:
+            n = snprintf(out, size, "[%u] unknown message type %u\n", h->seq, h->type);
+            break;
+    }
+    return n < (int)size ? n : (int)size - 1;
+}
+
+// the node's stream decoder, taking over the least recently used one if it has none
+static tc_decoder_t *decoder_for(int node, int64_t now_us) {
+    frame_decoder_t *pick = &decoders[0];
+    for (int i = 0; i < FRAME_DECODERS; i++) {
+        if (decoders[i].node == node) {
+            pick = &decoders[i];
+            break;
+        }
+        if (decoders[i].last_used_us < pick->last_used_us) pick = &decoders[i];
+    }
+    if (pick->node != node) {
+        pick->node = node;
+        tc_decoder_init(&pick->dec);
+    }
+    pick->last_used_us = now_us;
+    return &pick->dec;
+}
+
+// prints a reassembled frame as a FRAME line followed by one line of temperatures per row,
+// same comma separated layout as the PANO lines so the same scripts can read both
+static void print_frame(const frame_t *f, int64_t now_us) {
+    #ifdef HOST_LINK_BINARY
+    // the host has the codec too, send it still coded
+    hl_frame_t hf = {
+        .node = f->node,
+        .frame_id = f->frame_id,
+        .bearing = f->bearing,
+        .len = f->len,
+        .rx_ms = now_us / 1000,
+    };
+    host_uart_send(HL_MSG_FRAME, &hf, sizeof(hf), f->data, f->len);
+    #else
+    static char line[TC_COLS * 8 + 2];
+    static int16_t cells[TC_CELLS];
+    frame_stats_t st;
+    int err = tc_decode(decoder_for(f->node, now_us), f->data, f->len, cells);
+    if (err == TC_ERR_NO_REF) {
+        return;     // lost the frame before this one, wait for the next keyframe
+    }
+    if (err != TC_OK) {
+        ESP_LOGW(TAG, "Frame %u didn't decode (%d)", f->frame_id, err);
+        return;
+    }
+    frame_reassembly_stats(&st);
+    snprintf(line, sizeof(line), "n%02d FRAME %u %.2f (%u bytes, %lu complete, %lu incomplete, %lu bad crc, %lu late)\n",
+             f->node, f->frame_id, f->bearing / 100.0f, f->len, (unsigned long)st.completed,
+             (unsigned long)st.incomplete, (unsigned long)st.bad_crc, (unsigned long)st.late);
+    print_msg(line);
+    for (int r = 0; r < TC_ROWS; r++) {
+        int n = 0;
+        for (int c = 0; c < TC_COLS; c++) {
+            n += snprintf(line + n, sizeof(line) - n, "%.1f,", cells[r*TC_COLS + c] / 10.0f);
+        }
+        snprintf(line + n, sizeof(line) - n, "\n");
+        print_msg(line);
+    }
+    #endif
+}
+
+// Prints a reassembled black box frame as a BLACKBOX line (m is any of its fragments, they
+// all carry the frame's time and position) and its temperatures, laid out like a FRAME.
+// Each one is a keyframe, so it gets a decoder of its own.
+static void print_blackbox(const blackbox_frame_t *f, const fp_blackbox_t *m) {
+    static char line[TC_COLS * 8 + 2];
+    static int16_t cells[TC_CELLS];
+    static tc_decoder_t dec;
+    blackbox_stats_t st;
+    tc_decoder_init(&dec);
+    int err = tc_decode(&dec, f->data, f->len, cells);
+    if (err != TC_OK) {
+        ESP_LOGW(TAG, "Black box frame %u of incident %u didn't decode (%d)", f->frame, f->incident, err);
+        return;
+    }
+    blackbox_reassembly_stats(&st);
+    snprintf(line, sizeof(line), "n%02d BLACKBOX #%u frame %u at %+.1fs: pos %d, %.2f deg, %ld steps, %s, t_max %.1f "
+             "(%u bytes, %lu complete, %lu incomplete, %lu bad crc, %lu late)\n",
+             f->node, f->incident, f->frame, m->t_ms / 1000.0f, m->pos, m->bearing / 100.0f, (long)m->motor_steps,
+             fp_state_name(m->state), m->t_max / 10.0f, f->len, (unsigned long)st.completed,
+             (unsigned long)st.incomplete, (unsigned long)st.bad_crc, (unsigned long)st.late);
+    print_msg(line);
+    for (int r = 0; r < TC_ROWS; r++) {
+        int n = 0;
+        for (int c = 0; c < TC_COLS; c++) {
+            n += snprintf(line + n, sizeof(line) - n, "%.1f,", cells[r*TC_COLS + c] / 10.0f);
+        }
+        snprintf(line + n, sizeof(line) - n, "\n");
+        print_msg(line);
+    }
+}
+
+static uint32_t to_tick(int64_t us) {
+    return (uint32_t)(us / (TW_TICK_MS * 1000LL));
+}
+
+#ifdef HOST_LINK_BINARY
+static void send_node_event(const node_t *node, bool online, int64_t now_us) {
+    hl_node_t ev = {
+        .node = node_table_index(node),
+        .online = online,
+        .state = node->state,
+        .silent_ms = (now_us - (online ? node->offline_us : node->last_seen_us)) / 1000,
+    };
+    memcpy(ev.mac, node->mac, sizeof(ev.mac));
+    host_uart_send(HL_MSG_NODE, &ev, sizeof(ev), NULL, 0);
+}
+#endif
+
+// liveness timer ran out: the detector browned out, lost its link or hung
+static void on_node_timeout(tw_timer_t *timer, void *arg) {
+    node_t *node = arg;
+    node->offline = true;
+    node->offline_us = esp_timer_get_time();
+    #ifdef HOST_LINK_BINARY
+    send_node_event(node, false, node->offline_us);
+    #else
+    char line[120];
+    snprintf(line, sizeof(line), "n%02d OFFLINE: nothing heard for %.1fs, last state %s\n",
+             node_table_index(node), (node->offline_us - node->last_seen_us) / 1e6f,
+             fp_state_name(node->state));
+    print_msg(line);
+    #endif
+}
+
+// any packet from a node proves it's alive, push its deadline out
+static void watch_node(node_t *node, int64_t now_us) {
+    int period_s = node->heartbeat_s ? node->heartbeat_s : LIVENESS_DEFAULT_PERIOD_S;
+    if (node->liveness.cb == NULL) tw_timer_init(&node->liveness, on_node_timeout, node);
+    if (node->offline) {
+        node->offline = false;
+        #ifdef HOST_LINK_BINARY
+        send_node_event(node, true, now_us);
+        #else
+        char line[80];
+        snprintf(line, sizeof(line), "n%02d back ONLINE\n", node_table_index(node));
+        print_msg(line);
+        #endif
+    }
+    tw_add(&liveness_wheel, &node->liveness,
+           to_tick(now_us) + LIVENESS_MISSED_BEATS * period_s * 1000 / TW_TICK_MS);
+}
+
+// parse, dedupe and print one packet -- this is where the slow UART writes happen now
+static void handle_packet(const rx_packet_t *p) {
+    static char message[1024];  // a full panorama run prints ~700 characters
+    const fp_header_t *h = fp_parse(p->data, p->len);
+    if (h == NULL) {
+        rx_invalid++;
+        ESP_LOGW(TAG, "Dropped %d byte packet that isn't ours", p->len);
+        return;
+    }
+    // our own commands coming back from a relay that passed them on
+    if (h->type == FP_MSG_COMMAND) return;
+    // relayed packets are filed under the detector that sent them, not the relay
+    const fp_relay_t *relay = fp_relay_info(h, p->len);
+    const uint8_t *origin = relay ? relay->origin : p->mac;
+    // resends (the detector retries when an ack gets lost), floods and unknown nodes when
+    // the table is full are all counted in the node table and go no further
+    node_t *node;
+    if (node_table_accept(origin, h, p->rssi, p->rx_us, &node) != NODE_ACCEPT) {
+        return;
+    }
+    int idx = node_table_index(node);
+    uint8_t old_state = node->state;
+    node_table_update(node, h, p->rx_us);
+    node->hops = relay ? relay->hops : 0;
+    watch_node(node, p->rx_us);
+
+    if (h->type == FP_MSG_FRAME_FRAG) {
+        const frame_t *f = frame_reassembly_add(idx, fp_payload(h), h->len, p->rx_us);
+        if (f) print_frame(f, p->rx_us);
+        return;
+    }
+    #ifdef HOST_LINK_BINARY
+    // the host gets every message as it came over the radio and does its own filtering
+    hl_packet_t hp = {
+        .node = idx,
+        .rssi = p->rssi,
+        .hops = node->hops,
+        .rx_ms = p->rx_us / 1000,
+    };
+    memcpy(hp.mac, origin, sizeof(hp.mac));
+    host_uart_send(HL_MSG_PACKET, &hp, sizeof(hp), h, sizeof(fp_header_t) + h->len);
+    return;
+    #endif
+    if (h->type == FP_MSG_STATUS && node->state == old_state &&
+        p->rx_us - last_status_print_us[idx] < STATUS_PRINT_MS * 1000LL) {
+        return;
+    }
+    if (h->type == FP_MSG_STATUS) last_status_print_us[idx] = p->rx_us;
+    // the host reassembles black box frames itself, here it's done once all fragments are in
+    if (h->type == FP_MSG_BLACKBOX) {
+        const blackbox_frame_t *bf = blackbox_reassembly_add(idx, fp_payload(h), h->len, p->rx_us);
+        if (bf) print_blackbox(bf, fp_payload(h));
+        return;
+    }
+
+    // every line is tagged with the node it came from, see 'n' for which MAC that is
+    int n = snprintf(message, sizeof(message), "n%02d ", idx);
+    if (relay) {
+        n += snprintf(message + n, sizeof(message) - n, "(%u hops, %.1fms) ", relay->hops, relay->fwd_100us / 10.0f);
+    }
+    format_message(h, message + n, sizeof(message) - n);
     print_msg(message);
-    //ESP_LOGI(TAG, "Received Data: %c", *(char*)data); // Print received integer
+}
+
+// one line per detector: 'n' on the serial console
+static void print_nodes(void) {
+    char line[200];
+    int64_t now = esp_timer_get_time();
+    snprintf(line, sizeof(line), "%d nodes (%lu packets from nodes that didn't fit)\n", node_table_count(),
+             (unsigned long)node_table_rejected());
+    print_msg(line);
+    for (int i = 0; i < NODE_TABLE_SIZE; i++) {
+        const node_t *n = node_table_get(i);
+        if (!n) continue;
+        int len = snprintf(line, sizeof(line),
+                           "n%02d %02x:%02x:%02x:%02x:%02x:%02x %s%s, seen %.1fs ago, %u hops, rssi %.1f, %lu ok %lu lost %lu dup %lu limited",
+                           i, n->mac[0], n->mac[1], n->mac[2], n->mac[3], n->mac[4], n->mac[5],
+                           fp_state_name(n->state), n->offline ? " OFFLINE" : "", (now - n->last_seen_us) / 1e6f, n->hops, n->rssi_x16 / 16.0f,
+                           (unsigned long)n->packets, (unsigned long)n->lost, (unsigned long)n->duplicates,
+                           (unsigned long)n->rate_limited);
+        if (n->last_alert_us) {
+            len += snprintf(line + len, sizeof(line) - len, ", last alert %s %.1fs ago at %.2f deg",
+                            fp_state_name(n->last_alert.level), (now - n->last_alert_us) / 1e6f,
+                            n->last_alert.bearing / 100.0f);
+        }
+        snprintf(line + len, sizeof(line) - len, "\n");
+        print_msg(line);
+    }
+}
+
+static void rx_worker(void *arg) {
+    int64_t rate_start = esp_timer_get_time();
+    unsigned rate_count = atomic_load(&rx_ring.pushed);
+    while (1) {
+        // wake up at least once a wheel tick, so timeouts fire even when nothing arrives
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TW_TICK_MS));
+        rx_packet_t *p;
+        while ((p = rx_ring_peek(&rx_ring)) != NULL) {
+            handle_packet(p);
+            rx_ring_pop(&rx_ring);
+        }
+        int64_t now = esp_timer_get_time();
+        tw_advance(&liveness_wheel, to_tick(now));
+        if (now - rate_start >= 1000000) {
+            unsigned pushed = atomic_load(&rx_ring.pushed);
+            rx_rate = (pushed - rate_count) * 1e6f / (now - rate_start);
+            rate_count = pushed;
+            rate_start = now;
+        }
+    }
+}
+
+static void print_rx_stats(void) {
+    char line[160];
+    uint32_t duplicates = 0;
+    for (int i = 0; i < NODE_TABLE_SIZE; i++) {
+        const node_t *n = node_table_get(i);
+        if (n) duplicates += n->duplicates;
+    }
+    snprintf(line, sizeof(line), "rx: %.1f pkt/s, ring high water %u/%d, %u overflows, %lu duplicates, %lu invalid\n",
+             rx_rate, atomic_load(&rx_ring.high_water), RX_RING_SLOTS, atomic_load(&rx_ring.overflows),
+             (unsigned long)duplicates, (unsigned long)rx_invalid);
+    print_msg(line);
+}
+
+// Callback function when data is received -- runs in the wifi task, so it only copies the
+// packet into the ring and pokes the worker
+void on_data_recv(const esp_now_recv_info_t *info, const uint8_t *data, int len) {
+    if (rx_ring_push(&rx_ring, info, data, len, esp_timer_get_time())) {
+        xTaskNotifyGive(rx_worker_handle);
+    }
 }
 
 
@@ -28,7 +471,11 @@ void on_data_recv(const esp_now_recv_info_t *info, const uint8_t *data, int len)
 void uart_init() {
     // Configure UART parameters
     uart_config_t uart_config = {
+        #ifdef HOST_LINK_BINARY
+        .baud_rate = HOST_LINK_BAUD,
+        #else
         .baud_rate = 115200,    // Set baud rate
+        #endif
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
@@ -36,13 +483,22 @@ void uart_init() {
     };
 
     // Install UART driver and configure pins
+    #ifdef HOST_LINK_BINARY
+    // with a tx buffer a whole frame doesn't hold up the rx worker
+    uart_driver_install(UART_NUM_0, 1024, HOST_UART_TX_BUFFER, 0, NULL, 0);
+    #else
     uart_driver_install(UART_NUM_0, 1024, 0, 0, NULL, 0);
+    #endif
     uart_param_config(UART_NUM_0, &uart_config);
     uart_set_pin(UART_NUM_0, 17, 16, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
 }
 
 void app_main() {
+    // detectors drop a command with the same seq as the last one; starting from 0 every boot
+    // the first command after a reboot could be taken for the one before it
+    tx_seq = esp_random();
     uart_init();
+    host_uart_init();
     ESP_ERROR_CHECK(nvs_flash_init()); // Initialize flash storage (needed for ESP-NOW)
     ESP_ERROR_CHECK(esp_netif_init()); // Initialize networking stack
     ESP_ERROR_CHECK(esp_event_loop_create_default()); // Create event loop
@@ -58,8 +514,45 @@ void app_main() {
     }
 
     // Register callback for received data
+    frame_reassembly_init();
+    blackbox_reassembly_init();
+    node_table_init();
+    tw_init(&liveness_wheel, to_tick(esp_timer_get_time()));
+    for (int i = 0; i < FRAME_DECODERS; i++) decoders[i].node = -1;
+    rx_ring_init(&rx_ring);
+    xTaskCreate(rx_worker, "rx_worker", RX_WORKER_STACK, NULL, RX_WORKER_PRIORITY, &rx_worker_handle);
     esp_now_register_recv_cb(on_data_recv);
 
+    esp_now_peer_info_t peer = {};
+    memcpy(peer.peer_addr, broadcast_mac, 6);
+    peer.channel = 0;
+    peer.encrypt = false;
+    if (esp_now_add_peer(&peer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add broadcast peer");
+    }
+
     ESP_LOGI(TAG, "ESP-NOW Ready. Waiting for data...");
-    
+
+    // serial console commands for the detector:
+    //   'p' dump the 360 panorama, 's' / 'x' start / stop streaming every frame,
+    //   'l' send the processing timings, 'b' dump the black box
+    // 'r' prints the reciever's own ingest counters and 'n' the table of detectors
+    while (1) {
+        uint8_t c;
+        uint8_t cmd = 0;
+        if (uart_read_bytes(UART_NUM_0, &c, 1, pdMS_TO_TICKS(100)) != 1) continue;
+        if (c == 'p') cmd = FP_CMD_SEND_PANO;
+        if (c == 's') cmd = FP_CMD_STREAM_ON;
+        if (c == 'x') cmd = FP_CMD_STREAM_OFF;
+        if (c == 'l') cmd = FP_CMD_SEND_PERF;
+        if (c == 'b') cmd = FP_CMD_BLACKBOX;
+        if (c == 'r') print_rx_stats();
+        if (c == 'n') print_nodes();
+        if (cmd) {
+            uint8_t packet[sizeof(fp_header_t) + sizeof(fp_cmd_t)];
+            fp_init_header((fp_header_t *)packet, FP_MSG_COMMAND, tx_seq++, sizeof(fp_cmd_t));
+            ((fp_cmd_t *)(packet + sizeof(fp_header_t)))->cmd = cmd;
+            esp_now_send(broadcast_mac, packet, sizeof(packet));
+        }
+    }
 }
\ No newline at end of file
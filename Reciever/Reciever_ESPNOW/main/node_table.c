@@ -0,0 +1,177 @@
+#include <string.h>
+#include "node_table.h"
+
+static node_t nodes[NODE_TABLE_SIZE];
+static int node_count = 0;
+static uint32_t rejected = 0;           // packets from new nodes while the table was full
+
+void node_table_init(void) {
+    memset(nodes, 0, sizeof(nodes));
+    node_count = 0;
+    rejected = 0;
+}
+
+// FNV-1a over the MAC; the low bytes alone are too alike between boards from one batch
+static uint32_t mac_hash(const uint8_t *mac) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < ESP_NOW_ETH_ALEN; i++) {
+        h = (h ^ mac[i]) * 16777619u;
+    }
+    return h;
+}
+
+// finds the node's slot, or claims the first empty one on its probe path; NULL if full
+static node_t *find_or_add(const uint8_t *mac, int64_t now_us) {
+    uint32_t i = mac_hash(mac) & (NODE_TABLE_SIZE - 1);
+    for (int probes = 0; probes < NODE_TABLE_SIZE; probes++) {
+        node_t *n = &nodes[i];
+        if (!n->used) {
+            // keep one slot empty so lookups of unknown MACs always terminate early
+            if (node_count >= NODE_TABLE_SIZE - 1) return NULL;
+            memset(n, 0, sizeof(*n));
+            n->used = true;
+            memcpy(n->mac, mac, ESP_NOW_ETH_ALEN);
+            n->first_seen_us = now_us;
+            n->tokens = NODE_RATE_BURST;
+            n->bulk_tokens = NODE_BULK_BURST;
+            n->state = FP_STATE_BOOT;
+            node_count++;
+            return n;
+        }
+        if (memcmp(n->mac, mac, ESP_NOW_ETH_ALEN) == 0) return n;
+        i = (i + 1) & (NODE_TABLE_SIZE - 1);
+    }
+    return NULL;
+}
+
+// Sliding window over the 16 bit seq, like IPsec anti-replay: newer seqs move the window up
+// (a jump of more than one counts as lost packets), older ones inside the window are
+// resends if their bit is already set and late arrivals otherwise. Resends come within
+// ~120 ms, so an old seq after a long silence means the detector restarted.
+static bool seq_is_new(node_t *n, uint16_t seq, int64_t now_us) {
+    if (!n->have_seq) {
+        n->have_seq = true;
+        n->last_seq = seq;
+        n->seq_window = 1;
+        return true;
+    }
+    int16_t d = (int16_t)(seq - n->last_seq);
+    if (d > 0) {
+        n->lost += d - 1;
+        n->seq_window = (d >= NODE_SEQ_WINDOW) ? 1 : (n->seq_window << d) | 1;
+        n->last_seq = seq;
+        return true;
+    }
+    if (-d >= NODE_SEQ_RESET || now_us - n->last_seen_us > NODE_RESYNC_US) {
+        // the node restarted its counter
+        n->last_seq = seq;
+        n->seq_window = 1;
+        return true;
+    }
+    if (-d >= NODE_SEQ_WINDOW) return false;   // too old to tell, treat as a resend
+    uint64_t bit = 1ULL << -d;
+    if (n->seq_window & bit) return false;
+    n->seq_window |= bit;
+    if (n->lost) n->lost--;                     // it wasn't lost, just late
+    return true;
+}
+
+static bool is_bulk(uint8_t type) {
+    return type == FP_MSG_PANO || type == FP_MSG_BLACKBOX || type == FP_MSG_FRAME_FRAG;
+}
+
+// token buckets, both refilled by time since the node was last seen; takes from the one
+// the packet's type is counted against
+static bool take_token(node_t *n, uint8_t type, int64_t now_us) {
+    float dt_s = (now_us - n->last_seen_us) / 1e6f;
+    n->tokens += dt_s * NODE_RATE_PER_S;
+    if (n->tokens > NODE_RATE_BURST) n->tokens = NODE_RATE_BURST;
+    n->bulk_tokens += dt_s * NODE_BULK_RATE_PER_S;
+    if (n->bulk_tokens > NODE_BULK_BURST) n->bulk_tokens = NODE_BULK_BURST;
+    float *bucket = is_bulk(type) ? &n->bulk_tokens : &n->tokens;
+    if (*bucket < 1.0f) return false;
+    *bucket -= 1.0f;
+    return true;
+}
+
+// Looks up (or adds) the sender and decides what to do with the packet. Alerts are never
+// rate limited, bulk types have their own limit. *node is set whenever the sender has a
+// slot, even for rejected packets.
+node_verdict_t node_table_accept(const uint8_t *mac, const fp_header_t *h, int8_t rssi, int64_t now_us, node_t **node) {
+    node_t *n = find_or_add(mac, now_us);
+    *node = n;
+    if (n == NULL) {
+        rejected++;
+        return NODE_TABLE_FULL;
+    }
+
+    if (!n->have_seq) {
+        n->rssi_x16 = rssi * 16;
+    } else {
+        n->rssi_x16 += (rssi * 16 - n->rssi_x16) / NODE_RSSI_SMOOTHING;
+    }
+    bool is_new = seq_is_new(n, h->seq, now_us);
+    bool allowed = take_token(n, h->type, now_us) || h->type == FP_MSG_ALERT;
+    n->last_seen_us = now_us;
+
+    if (!is_new) {
+        n->duplicates++;
+        return NODE_DUPLICATE;
+    }
+    if (!allowed) {
+        n->rate_limited++;
+        return NODE_RATE_LIMITED;
+    }
+    n->packets++;
+    return NODE_ACCEPT;
+}
+
+// pulls node state out of an accepted message, or out of each record of a batch
+void node_table_update(node_t *n, const fp_header_t *h, int64_t now_us) {
+    const void *p = fp_payload(h);
+    switch (h->type) {
+        case FP_MSG_BATCH: {
+            uint8_t one[FP_MAX_PACKET];
+            size_t offset = 0;
+            const fp_record_t *r;
+            while ((r = fp_next_record(h, &offset)) != NULL) {
+                fp_init_header((fp_header_t *)one, r->type, h->seq, r->len);
+                memcpy(one + sizeof(fp_header_t), r->data, r->len);
+                node_table_update(n, (const fp_header_t *)one, now_us);
+            }
+            break;
+        }
+        case FP_MSG_STATUS:
+            n->state = ((const fp_status_t *)p)->state;
+            break;
+        case FP_MSG_ALERT:
+            n->last_alert = *(const fp_alert_t *)p;
+            n->last_alert_us = now_us;
+            n->state = n->last_alert.level;
+            break;
+        case FP_MSG_HEARTBEAT:
+            n->state = ((const fp_heartbeat_t *)p)->state;
+            n->heartbeat_s = ((const fp_heartbeat_t *)p)->period_s;
+            break;
+        default:
+            break;
+    }
+}
+
+// slot by index (0 .. NODE_TABLE_SIZE-1), NULL if empty
+node_t *node_table_get(int index) {
+    if (index < 0 || index >= NODE_TABLE_SIZE || !nodes[index].used) return NULL;
+    return &nodes[index];
+}
+
+int node_table_index(const node_t *n) {
+    return n - nodes;
+}
+
+int node_table_count(void) {
+    return node_count;
+}
+
+uint32_t node_table_rejected(void) {
+    return rejected;
+}
@@ -0,0 +1,68 @@
+#ifndef NODE_TABLE_H
+#define NODE_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_now.h"
+#include "fire_protocol.h"
+#include "timer_wheel.h"
+
+// Everything the reciever knows about each detector, in a fixed open-addressed hash table
+// keyed by MAC (linear probing, no deletion -- a detector that goes quiet keeps its slot).
+// Also decides per packet whether it's new, a resend we've already seen, or over that
+// node's rate limit.
+#define NODE_TABLE_SIZE 64              // power of two, keep it well above the node count
+#define NODE_SEQ_WINDOW 64              // how far back resends are recognised
+#define NODE_SEQ_RESET 1024             // a seq this far behind means the node rebooted ...
+#define NODE_RESYNC_US 2000000          // ... as does any older seq after this much silence
+#define NODE_RATE_PER_S 20              // sustained messages/s per node (alerts exempt)
+#define NODE_RATE_BURST 40
+// Panorama runs, black box dumps and frame fragments come in bursts we asked for (or that an
+// alarm started), so they get their own bucket and don't starve status and heartbeats or get
+// their tail cut off. A panorama is ~50 packets in a go.
+#define NODE_BULK_RATE_PER_S 20
+#define NODE_BULK_BURST 64
+#define NODE_RSSI_SMOOTHING 8           // rssi is averaged over ~this many packets
+
+typedef enum {
+    NODE_ACCEPT = 0,
+    NODE_DUPLICATE,
+    NODE_RATE_LIMITED,
+    NODE_TABLE_FULL,
+} node_verdict_t;
+
+typedef struct {
+    bool used;
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    uint8_t state;                      // fp_state_t from the last status/alert
+    bool have_seq;
+    uint16_t last_seq;                  // highest seq seen
+    uint64_t seq_window;                // bit i set = last_seq - i has been seen
+    int64_t first_seen_us;
+    int64_t last_seen_us;
+    int16_t rssi_x16;                   // smoothed rssi, 1/16 dBm (of the last hop if relayed)
+    uint8_t hops;                       // relays the last packet went through, 0 = direct
+    uint32_t packets;                   // accepted
+    uint32_t lost;                      // seq gaps that never got filled
+    uint32_t duplicates;
+    uint32_t rate_limited;
+    float tokens;                       // rate limit bucket
+    float bulk_tokens;                  // same for the bulk types
+    fp_alert_t last_alert;
+    int64_t last_alert_us;              // 0 = never
+    uint8_t heartbeat_s;                // period from its last heartbeat, 0 = none yet
+    bool offline;                       // missed its heartbeats, see LIVENESS_* in main.c
+    int64_t offline_us;                 // when it was last declared offline
+    tw_timer_t liveness;                // re-armed by every packet, fires when it goes quiet
+} node_t;
+
+// Function Declarations
+void node_table_init(void);
+node_verdict_t node_table_accept(const uint8_t *mac, const fp_header_t *h, int8_t rssi, int64_t now_us, node_t **node);
+void node_table_update(node_t *node, const fp_header_t *h, int64_t now_us);
+node_t *node_table_get(int index);
+int node_table_index(const node_t *node);
+int node_table_count(void);
+uint32_t node_table_rejected(void);
+
+#endif // NODE_TABLE_H
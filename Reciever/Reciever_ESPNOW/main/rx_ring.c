@@ -0,0 +1,52 @@
+#include <string.h>
+#include "rx_ring.h"
+
+void rx_ring_init(rx_ring_t *ring) {
+    memset(ring, 0, sizeof(*ring));
+}
+
+// Producer side, called from the recv callback: one memcpy into the next free slot.
+// Returns false (and counts an overflow) if the worker hasn't caught up.
+bool rx_ring_push(rx_ring_t *ring, const esp_now_recv_info_t *info, const uint8_t *data, int len, int64_t now_us) {
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    unsigned depth = head - tail;
+    if (depth >= RX_RING_SLOTS) {
+        atomic_fetch_add_explicit(&ring->overflows, 1, memory_order_relaxed);
+        return false;
+    }
+    if (len > RX_SLOT_BYTES) len = RX_SLOT_BYTES;
+
+    rx_packet_t *p = &ring->slots[head & (RX_RING_SLOTS - 1)];
+    p->rx_us = now_us;
+    memcpy(p->mac, info->src_addr, ESP_NOW_ETH_ALEN);
+    p->rssi = info->rx_ctrl ? info->rx_ctrl->rssi : 0;
+    p->len = len;
+    memcpy(p->data, data, len);
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    atomic_fetch_add_explicit(&ring->pushed, 1, memory_order_relaxed);
+    if (depth + 1 > atomic_load_explicit(&ring->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->high_water, depth + 1, memory_order_relaxed);
+    }
+    return true;
+}
+
+// Consumer side: oldest packet, or NULL if the ring is empty. The slot stays ours until
+// rx_ring_pop, so the worker can parse it in place.
+rx_packet_t *rx_ring_peek(rx_ring_t *ring) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail) return NULL;
+    return &ring->slots[tail & (RX_RING_SLOTS - 1)];
+}
+
+void rx_ring_pop(rx_ring_t *ring) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+unsigned rx_ring_depth(rx_ring_t *ring) {
+    return atomic_load_explicit(&ring->head, memory_order_acquire) -
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
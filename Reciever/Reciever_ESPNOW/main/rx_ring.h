@@ -0,0 +1,40 @@
+#ifndef RX_RING_H
+#define RX_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "esp_now.h"
+
+// Single producer (the wifi task's recv callback) / single consumer (the rx worker) ring of
+// fixed-size packet slots. No locks: the producer only writes `head`, the consumer only
+// writes `tail`, and each publishes with a release store after its memcpy is done.
+// When the ring is full new packets are dropped and counted, the callback never waits.
+#define RX_RING_SLOTS 64            // power of two, ~0.1 s of dozens of detectors at 10 msgs/s
+#define RX_SLOT_BYTES ESP_NOW_MAX_DATA_LEN
+
+typedef struct {
+    int64_t rx_us;              // esp_timer time it arrived
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    int8_t rssi;
+    uint16_t len;
+    uint8_t data[RX_SLOT_BYTES];
+} rx_packet_t;
+
+typedef struct {
+    rx_packet_t slots[RX_RING_SLOTS];
+    atomic_uint head;           // next slot to fill, only the producer writes it
+    atomic_uint tail;           // next slot to read, only the consumer writes it
+    atomic_uint pushed;
+    atomic_uint overflows;
+    atomic_uint high_water;
+} rx_ring_t;
+
+// Function Declarations
+void rx_ring_init(rx_ring_t *ring);
+bool rx_ring_push(rx_ring_t *ring, const esp_now_recv_info_t *info, const uint8_t *data, int len, int64_t now_us);
+rx_packet_t *rx_ring_peek(rx_ring_t *ring);
+void rx_ring_pop(rx_ring_t *ring);
+unsigned rx_ring_depth(rx_ring_t *ring);
+
+#endif // RX_RING_H
@@ -0,0 +1,120 @@
+#include <stddef.h>
+#include "timer_wheel.h"
+
+#define SLOT_MASK (TW_SLOTS - 1)
+#define MAX_DELTA ((1u << (TW_BITS * TW_LEVELS)) - 1)
+
+static void list_init(tw_timer_t *head) {
+    head->next = head;
+    head->prev = head;
+}
+
+static void list_append(tw_timer_t *head, tw_timer_t *t) {
+    t->prev = head->prev;
+    t->next = head;
+    head->prev->next = t;
+    head->prev = t;
+}
+
+static void unlink(tw_timer_t *t) {
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = NULL;
+    t->prev = NULL;
+}
+
+// puts the timer in the slot for its expiry, on the lowest level whose range reaches it
+static void place(tw_wheel_t *w, tw_timer_t *t) {
+    uint32_t delta = t->expires - w->next_tick;
+    if ((int32_t)delta < 0) {
+        // already due, fires on the next tick
+        t->expires = w->next_tick;
+        delta = 0;
+    } else if (delta > MAX_DELTA) {
+        t->expires = w->next_tick + MAX_DELTA;
+        delta = MAX_DELTA;
+    }
+    int level = 0;
+    while (level < TW_LEVELS - 1 && delta >= (1u << (TW_BITS * (level + 1)))) level++;
+    list_append(&w->slots[level][(t->expires >> (TW_BITS * level)) & SLOT_MASK], t);
+}
+
+// moves a whole slot list over to `to`, leaving the slot empty
+static void list_take(tw_timer_t *head, tw_timer_t *to) {
+    if (head->next == head) {
+        list_init(to);
+        return;
+    }
+    to->next = head->next;
+    to->prev = head->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+    list_init(head);
+}
+
+// moves every timer of one higher-level slot down to where it belongs now
+static void cascade(tw_wheel_t *w, int level, int index) {
+    tw_timer_t pending;
+    // take the whole list first, place() may put timers back into this slot
+    list_take(&w->slots[level][index], &pending);
+    while (pending.next != &pending) {
+        tw_timer_t *t = pending.next;
+        unlink(t);
+        place(w, t);
+    }
+}
+
+void tw_init(tw_wheel_t *wheel, uint32_t now_tick) {
+    for (int l = 0; l < TW_LEVELS; l++) {
+        for (int i = 0; i < TW_SLOTS; i++) list_init(&wheel->slots[l][i]);
+    }
+    wheel->next_tick = now_tick;
+    wheel->fired = 0;
+}
+
+void tw_timer_init(tw_timer_t *timer, tw_callback_t cb, void *arg) {
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->expires = 0;
+    timer->cb = cb;
+    timer->arg = arg;
+}
+
+// arms (or re-arms) the timer to fire on tick `expires`
+void tw_add(tw_wheel_t *wheel, tw_timer_t *timer, uint32_t expires) {
+    if (timer->next) unlink(timer);
+    timer->expires = expires;
+    place(wheel, timer);
+}
+
+void tw_cancel(tw_timer_t *timer) {
+    if (timer->next) unlink(timer);
+}
+
+bool tw_armed(const tw_timer_t *timer) {
+    return timer->next != NULL;
+}
+
+// Runs every tick up to and including now_tick. A callback may re-arm its own timer or any
+// other one.
+void tw_advance(tw_wheel_t *wheel, uint32_t now_tick) {
+    while ((int32_t)(now_tick - wheel->next_tick) >= 0) {
+        uint32_t tick = wheel->next_tick;
+        // level 0 wrapped: bring the next block of ticks down from the levels above
+        for (int l = 1; l < TW_LEVELS; l++) {
+            if ((tick >> (TW_BITS * (l - 1))) & SLOT_MASK) break;
+            cascade(wheel, l, (tick >> (TW_BITS * l)) & SLOT_MASK);
+        }
+        // a callback re-arming for 64 ticks from now lands in this same slot, so take the
+        // list first
+        tw_timer_t due;
+        list_take(&wheel->slots[0][tick & SLOT_MASK], &due);
+        wheel->next_tick++;
+        while (due.next != &due) {
+            tw_timer_t *t = due.next;
+            unlink(t);
+            wheel->fired++;
+            t->cb(t, t->arg);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Hierarchical timer wheel (the old Linux kernel timer layout), used for per-node liveness
+// timeouts. Time is in ticks of TW_TICK_MS. Level 0 has one slot per tick for the next
+// TW_SLOTS ticks, each higher level covers TW_SLOTS times more per slot; when level 0 wraps
+// the next slot of level 1 is spread back down (and so on). Adding, re-arming and cancelling
+// a timer is O(1), a tick is O(1) plus the timers that actually fire, no matter how many
+// nodes are being watched. Timers live inside the caller's structs, nothing is allocated.
+// Not thread safe: add/cancel/advance from one task only.
+#define TW_TICK_MS 100
+#define TW_BITS 6
+#define TW_SLOTS (1 << TW_BITS)
+#define TW_LEVELS 3                 // 64^3 ticks = ~7 hours at 100 ms, longer ones are clamped
+
+typedef struct tw_timer tw_timer_t;
+typedef void (*tw_callback_t)(tw_timer_t *timer, void *arg);
+
+struct tw_timer {
+    tw_timer_t *next;           // NULL when not armed
+    tw_timer_t *prev;
+    uint32_t expires;           // tick it fires on
+    tw_callback_t cb;
+    void *arg;
+};
+
+typedef struct {
+    uint32_t next_tick;         // next tick to be processed
+    tw_timer_t slots[TW_LEVELS][TW_SLOTS];   // list heads (circular, self = empty)
+    uint32_t fired;
+} tw_wheel_t;
+
+// Function Declarations
+void tw_init(tw_wheel_t *wheel, uint32_t now_tick);
+void tw_timer_init(tw_timer_t *timer, tw_callback_t cb, void *arg);
+void tw_add(tw_wheel_t *wheel, tw_timer_t *timer, uint32_t expires);
+void tw_cancel(tw_timer_t *timer);
+bool tw_armed(const tw_timer_t *timer);
+void tw_advance(tw_wheel_t *wheel, uint32_t now_tick);
+
+#endif // TIMER_WHEEL_H
@@ -16,7 +16,7 @@
  */
 
  // got this file from https://github.com/netzbasteln/MLX90640-Thermocam/blob/master/MLX90640_API.cpp
- // did not modify
+ // only modification: MLX90640_CalculateToTiles(), which skips pixels outside a tile mask
 #include "MLX90640_I2C_Driver.h"
 #include "MLX90640_API.h"
 #include <math.h>
@@ -268,6 +268,15 @@ int MLX90640_GetCurMode(uint8_t slaveAddr)
 //------------------------------------------------------------------------------
 
 void MLX90640_CalculateTo(uint16_t *frameData, const paramsMLX90640 *params, float emissivity, float tr, float *result)
+{
+    MLX90640_CalculateToTiles(frameData, params, emissivity, tr, result, MLX90640_ALL_TILES);
+}
+
+//------------------------------------------------------------------------------
+
+// same as MLX90640_CalculateTo but only pixels in tiles set in tileMask are written,
+// the rest of result is left untouched
+void MLX90640_CalculateToTiles(uint16_t *frameData, const paramsMLX90640 *params, float emissivity, float tr, float *result, uint64_t tileMask)
 {
     float vdd;
     float ta;
@@ -335,6 +344,11 @@ void MLX90640_CalculateTo(uint16_t *frameData, const paramsMLX90640 *params, flo
 
     for( int pixelNumber = 0; pixelNumber < 768; pixelNumber++)
     {
+        if(((tileMask >> MLX90640_TILE_OF(pixelNumber)) & 1) == 0)
+        {
+            continue;
+        }
+        
         ilPattern = pixelNumber / 32 - (pixelNumber / 64) * 2; 
         chessPattern = ilPattern ^ (pixelNumber - (pixelNumber/2)*2); 
         conversionPattern = ((pixelNumber + 2) / 4 - (pixelNumber + 3) / 4 + (pixelNumber + 1) / 4 - pixelNumber / 4) * (1 - 2 * ilPattern);
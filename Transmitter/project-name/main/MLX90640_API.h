@@ -49,6 +49,14 @@
         uint16_t brokenPixels[5];
         uint16_t outlierPixels[5];  
     } paramsMLX90640;
+
+// the 32x24 frame split into 8x6 tiles of 4x4 pixels, tile n is bit n of a tile mask
+#define MLX90640_TILE_SIZE 4
+#define MLX90640_TILES_X 8
+#define MLX90640_TILES_Y 6
+#define MLX90640_NUM_TILES 48
+#define MLX90640_ALL_TILES 0xFFFFFFFFFFFFULL
+#define MLX90640_TILE_OF(pixelNumber) ((((pixelNumber) >> 7) << 3) + (((pixelNumber) & 31) >> 2))
     
     int MLX90640_DumpEE(uint8_t slaveAddr, uint16_t *eeData);
     int MLX90640_GetFrameData(uint8_t slaveAddr, uint16_t *frameData);
@@ -57,6 +65,7 @@
     float MLX90640_GetTa(uint16_t *frameData, const paramsMLX90640 *params);
     void MLX90640_GetImage(uint16_t *frameData, const paramsMLX90640 *params, float *result);
     void MLX90640_CalculateTo(uint16_t *frameData, const paramsMLX90640 *params, float emissivity, float tr, float *result);
+    void MLX90640_CalculateToTiles(uint16_t *frameData, const paramsMLX90640 *params, float emissivity, float tr, float *result, uint64_t tileMask);
     int MLX90640_SetResolution(uint8_t slaveAddr, uint8_t resolution);
     int MLX90640_GetCurResolution(uint8_t slaveAddr);
     int MLX90640_SetRefreshRate(uint8_t slaveAddr, uint8_t refreshRate);   
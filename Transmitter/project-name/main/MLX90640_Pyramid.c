@@ -0,0 +1,72 @@
+/**
+ * Coarse-to-fine search structure over a raw MLX90640 frame, see MLX90640_Pyramid.h
+ */
+#include "MLX90640_Pyramid.h"
+
+// Level 1 is built from the raw words minus each pixel's EEPROM offset. That takes out the
+// fixed pattern between pixels so the tile maxima can be compared against each other; the
+// remaining gain and alpha differences are a few percent, which is fine for a coarse test.
+void MLX90640_BuildPyramid(uint16_t *frameData, const paramsMLX90640 *params, pyramidMLX90640 *pyramid)
+{
+    int32_t frameSum = 0;
+    int32_t frameMax = INT32_MIN;
+
+    for(int t = 0; t < MLX90640_NUM_TILES; t++)
+    {
+        pyramid->tileMax[t] = INT32_MIN;
+        pyramid->tileSum[t] = 0;
+    }
+
+    for(int pixelNumber = 0; pixelNumber < 768; pixelNumber++)
+    {
+        int t = MLX90640_TILE_OF(pixelNumber);
+        int16_t raw = (int16_t)frameData[pixelNumber];
+        int32_t compensated = raw - params->offset[pixelNumber];
+
+        pyramid->tileSum[t] += raw;
+        if(compensated > pyramid->tileMax[t])
+        {
+            pyramid->tileMax[t] = compensated;
+        }
+        if(compensated > frameMax)
+        {
+            frameMax = compensated;
+        }
+        frameSum += compensated;
+    }
+
+    pyramid->frameMean = frameSum / 768;
+    pyramid->frameMax = frameMax;
+}
+
+//------------------------------------------------------------------------------
+
+// tiles whose brightest pixel is at least delta counts above the frame mean
+uint64_t MLX90640_PyramidHotTiles(const pyramidMLX90640 *pyramid, int32_t delta)
+{
+    uint64_t mask = 0;
+    int32_t threshold = pyramid->frameMean + delta;
+
+    for(int t = 0; t < MLX90640_NUM_TILES; t++)
+    {
+        if(pyramid->tileMax[t] >= threshold)
+        {
+            mask |= 1ULL << t;
+        }
+    }
+    return mask;
+}
+
+//------------------------------------------------------------------------------
+
+// grows a tile mask by one tile in every direction (8-neighbour), so a blob sitting on
+// a tile edge still gets its whole footprint calibrated
+uint64_t MLX90640_DilateTiles(uint64_t tileMask)
+{
+    // column masks stop the shifts from wrapping into the next tile row
+    const uint64_t notLeftCol = 0xFEFEFEFEFEFEULL;
+    const uint64_t notRightCol = 0x7F7F7F7F7F7FULL;
+    uint64_t rows = tileMask | ((tileMask << 1) & notLeftCol) | ((tileMask >> 1) & notRightCol);
+
+    return (rows | (rows << MLX90640_TILES_X) | (rows >> MLX90640_TILES_X)) & MLX90640_ALL_TILES;
+}
@@ -0,0 +1,36 @@
+/**
+ * Coarse-to-fine search structure over a raw MLX90640 frame.
+ *
+ * Level 0 is the 32x24 frame itself, level 1 is the 8x6 grid of 4x4 pixel tiles
+ * (see MLX90640_TILE_* in MLX90640_API.h) with the raw max and sum of each tile.
+ * Building it is one integer pass over the frame, so it's cheap enough to run on every
+ * frame and decide which tiles are worth calibrating at all.
+ */
+
+ #ifdef __cplusplus
+ extern "C" {
+ #endif
+
+#ifndef _MLX640_PYRAMID_H_
+#define _MLX640_PYRAMID_H_
+
+#include <stdint.h>
+#include "MLX90640_API.h"
+
+    typedef struct
+    {
+        int32_t tileMax[MLX90640_NUM_TILES];    // max of (raw - pixel offset) in each tile
+        int32_t tileSum[MLX90640_NUM_TILES];    // sum of raw words in each tile
+        int32_t frameMean;                      // mean of (raw - pixel offset) over the frame
+        int32_t frameMax;
+    } pyramidMLX90640;
+
+    void MLX90640_BuildPyramid(uint16_t *frameData, const paramsMLX90640 *params, pyramidMLX90640 *pyramid);
+    uint64_t MLX90640_PyramidHotTiles(const pyramidMLX90640 *pyramid, int32_t delta);
+    uint64_t MLX90640_DilateTiles(uint64_t tileMask);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "dspi_conv.h"
+#include "main.h"
+#include "MLX90640_API.h"
+#include "MLX90640_Pyramid.h"
+#include "hotspot.h"
+#include "thermal_filter.h"
+#include "benchmarks.h"
+
+static float bench_full[NUM_ROWS*NUM_COLS];
+static float bench_coarse[NUM_ROWS*NUM_COLS];
+static float bench_out[NUM_ROWS*NUM_COLS];
+static hotspot_blob_t bench_blobs[HOTSPOT_MAX_BLOBS];
+
+// Full calibration + blob search over the whole frame vs. the coarse-to-fine path
+// (pyramid, hot tiles, calibration and blob search only inside them), on whatever the
+// sensor is looking at. Prints per frame and averaged results:
+//   frame <n>: tiles <passed>/48 full <us> coarse <us> blobs <full>/<coarse>
+void benchmark_pyramid(const paramsMLX90640 *params, uint16_t *frameData, int frames) {
+    char message[100];
+    int64_t total_full = 0, total_coarse = 0;
+    int total_tiles = 0;
+    pyramidMLX90640 pyramid;
+
+    print_msg("benchmark: pyramid vs full frame\n");
+    for (int f = 0; f < frames; f++) {
+        MLX90640_GetFrameData(DEVICE_ADDR, frameData);
+        float ta = MLX90640_GetTa(frameData, params);
+
+        int64_t t0 = esp_timer_get_time();
+        MLX90640_CalculateTo(frameData, params, 0.95, ta-8, bench_full);
+        float thr = hotspot_frame_mean(bench_full) + HOTSPOT_DELTA_C;
+        int n_full = hotspot_find(bench_full, MLX90640_ALL_TILES, thr, bench_blobs, HOTSPOT_MAX_BLOBS);
+        int64_t t1 = esp_timer_get_time();
+
+        MLX90640_BuildPyramid(frameData, params, &pyramid);
+        uint64_t hot = MLX90640_DilateTiles(MLX90640_PyramidHotTiles(&pyramid, PYRAMID_HOT_DELTA));
+        MLX90640_CalculateToTiles(frameData, params, 0.95, ta-8, bench_coarse, hot);
+        int n_coarse = hotspot_find(bench_coarse, hot, thr, bench_blobs, HOTSPOT_MAX_BLOBS);
+        int64_t t2 = esp_timer_get_time();
+
+        int tiles = __builtin_popcountll(hot);
+        sprintf(message, "frame %d: tiles %d/%d full %dus coarse %dus blobs %d/%d\n", f, tiles,
+                MLX90640_NUM_TILES, (int)(t1 - t0), (int)(t2 - t1), n_full, n_coarse);
+        print_msg(message);
+        total_full += t1 - t0;
+        total_coarse += t2 - t1;
+        total_tiles += tiles;
+    }
+    if (frames > 0) {
+        sprintf(message, "average: tiles %.1f/%d full %dus coarse %dus (%.0f%% of the work saved)\n",
+                (float)total_tiles / frames, MLX90640_NUM_TILES, (int)(total_full / frames),
+                (int)(total_coarse / frames), 100.0f * (1.0f - (float)total_coarse / total_full));
+        print_msg(message);
+    }
+}
+
+// Our in-place 3x3 median and separable gaussian against esp-dsp's generic 2D convolution
+// (dspi_conv_f32_ansi) running the same gaussian kernel. Each filter runs on a fresh copy of
+// image every iteration, the copy isn't part of the timing.
+void benchmark_filters(const float *image, int iterations) {
+    char message[100];
+    static float kernel[9] = { 1/16.0f, 2/16.0f, 1/16.0f,
+                               2/16.0f, 4/16.0f, 2/16.0f,
+                               1/16.0f, 2/16.0f, 1/16.0f };
+    image2d_t in = { .data = bench_full, .step_x = 1, .step_y = 1, .stride_x = NUM_COLS, .stride_y = NUM_ROWS,
+                     .size_x = NUM_COLS, .size_y = NUM_ROWS };
+    image2d_t filter = { .data = kernel, .step_x = 1, .step_y = 1, .stride_x = 3, .stride_y = 3,
+                         .size_x = 3, .size_y = 3 };
+    image2d_t out = { .data = bench_out, .step_x = 1, .step_y = 1, .stride_x = NUM_COLS, .stride_y = NUM_ROWS,
+                      .size_x = NUM_COLS, .size_y = NUM_ROWS };
+    int64_t t_median = 0, t_gauss = 0, t_dsp = 0;
+
+    print_msg("benchmark: 3x3 filters on a 32x24 frame\n");
+    for (int i = 0; i < iterations; i++) {
+        memcpy(bench_full, image, sizeof(bench_full));
+        int64_t t1 = esp_timer_get_time();
+        thermal_median3x3(bench_full, NUM_ROWS, NUM_COLS);
+        int64_t t2 = esp_timer_get_time();
+        memcpy(bench_full, image, sizeof(bench_full));
+        int64_t t3 = esp_timer_get_time();
+        thermal_gaussian3x3(bench_full, NUM_ROWS, NUM_COLS);
+        int64_t t4 = esp_timer_get_time();
+        memcpy(bench_full, image, sizeof(bench_full));
+        int64_t t5 = esp_timer_get_time();
+        dspi_conv_f32_ansi(&in, &filter, &out);
+        int64_t t6 = esp_timer_get_time();
+
+        t_median += t2 - t1;
+        t_gauss += t4 - t3;
+        t_dsp += t6 - t5;
+    }
+    if (iterations > 0) {
+        sprintf(message, "median %dus gaussian %dus dspi_conv_f32_ansi %dus\n",
+                (int)(t_median / iterations), (int)(t_gauss / iterations), (int)(t_dsp / iterations));
+        print_msg(message);
+    }
+}
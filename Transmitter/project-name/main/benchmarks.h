@@ -0,0 +1,12 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <stdint.h>
+#include "MLX90640_API.h"
+
+// Timing runs over live frames, enabled with RUN_BENCHMARKS in main.c.
+// Results go out over the UART with print_msg.
+void benchmark_pyramid(const paramsMLX90640 *params, uint16_t *frameData, int frames);
+void benchmark_filters(const float *image, int iterations);
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "thermal_codec.h"
+#include "wireless_esp.h"
+#include "main.h"
+#include "perf.h"
+#include "dlog.h"
+#include "blackbox.h"
+#ifdef BLACKBOX_TO_FLASH
+#include "esp_littlefs.h"
+#endif
+
+// A frame in the ring: its bytes are ring[offset .. offset + meta.len), never split at the
+// end of the buffer. entries[] is oldest first from `first`, the bytes go round ring[] in the
+// same order.
+typedef struct {
+    blackbox_meta_t meta;
+    uint32_t offset;
+} entry_t;
+
+static uint8_t ring[BLACKBOX_BUDGET_BYTES];
+static entry_t entries[BLACKBOX_MAX_FRAMES];
+static int first = 0;
+static int count = 0;
+static uint32_t write_pos = 0;          // where the next frame goes if it fits before the end
+static uint32_t next_seq = 0;
+static uint32_t dropped = 0;
+
+// the incident being dumped; everything above is under `lock` too
+static bool dumping = false;
+static bool armed = true;               // the alarm cleared since the last trigger
+static uint32_t send_seq;               // next frame for the task, the ones before it may go
+static uint32_t last_seq;               // trigger frame + BLACKBOX_POST_FRAMES
+static int64_t trigger_us;
+
+static SemaphoreHandle_t lock;
+static StaticSemaphore_t lock_buf;
+static TaskHandle_t task;
+static StackType_t task_stack[BLACKBOX_TASK_STACK];
+static StaticTask_t task_tcb;
+
+static tc_encoder_t encoder;            // blackbox_add only, i.e. the alert stage
+static int16_t cells[TC_CELLS];
+static uint8_t coded[TC_MAX_ENCODED];
+static uint8_t sending[TC_MAX_ENCODED]; // the task's copy of the frame it's on
+static bool flash = false;
+
+static void blackbox_task(void *arg);
+
+esp_err_t blackbox_init(void) {
+    // every frame a keyframe, so any run of them decodes
+    tc_encoder_init(&encoder, 1, BLACKBOX_MAX_ERROR);
+    lock = xSemaphoreCreateMutexStatic(&lock_buf);
+    task = xTaskCreateStaticPinnedToCore(blackbox_task, "blackbox", BLACKBOX_TASK_STACK, NULL, BLACKBOX_TASK_PRIORITY,
+                                         task_stack, &task_tcb, 0);
+    return ESP_OK;
+}
+
+// Throws out the oldest frame, unless it's part of an incident that hasn't been sent yet.
+static bool drop_oldest(void) {
+    if (dumping && entries[first].meta.seq >= send_seq) return false;
+    first = (first + 1) % BLACKBOX_MAX_FRAMES;
+    count--;
+    return true;
+}
+
+// Finds n bytes in a row for a new frame, dropping the oldest frames in the way. Returns the
+// offset, or -1 if that would mean dropping frames of the incident being sent.
+static int make_room(uint32_t n) {
+    if (count == BLACKBOX_MAX_FRAMES && !drop_oldest()) return -1;
+    uint32_t at = write_pos;
+    if (at + n > BLACKBOX_BUDGET_BYTES) {
+        // the rest of the buffer is skipped, whatever is still in it is from the last lap
+        while (count && entries[first].offset >= at) {
+            if (!drop_oldest()) return -1;
+        }
+        at = 0;
+    }
+    while (count && entries[first].offset < at + n && entries[first].offset + entries[first].meta.len > at) {
+        if (!drop_oldest()) return -1;
+    }
+    return at;
+}
+
+// under lock
+static void start_dump(void) {
+    if (dumping) return;
+    dumping = true;
+    // the newest frames up to BLACKBOX_PRE_BYTES, the older ones make room for what comes next
+    uint32_t bytes = 0;
+    int keep = 0;
+    while (keep < count) {
+        const entry_t *e = &entries[(first + count - 1 - keep) % BLACKBOX_MAX_FRAMES];
+        if (bytes + e->meta.len > BLACKBOX_PRE_BYTES) break;
+        bytes += e->meta.len;
+        keep++;
+    }
+    send_seq = keep ? entries[(first + count - keep) % BLACKBOX_MAX_FRAMES].meta.seq : next_seq;
+    last_seq = next_seq - 1 + BLACKBOX_POST_FRAMES;
+    trigger_us = esp_timer_get_time();
+}
+
+// Called by the alert stage with every frame. Costs an encode and a copy, the dump itself
+// happens in blackbox_task.
+void blackbox_add(const float *image, const scan_tag_t *tag, float bearing, float t_max, uint8_t state) {
+    perf_mark_t p = perf_now();
+    tc_quantize(image, cells);
+    int len = tc_encode(&encoder, cells, coded, sizeof(coded));
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    int at = len < 0 ? -1 : make_room(len);
+    if (at < 0) {
+        dropped++;
+    } else {
+        entry_t *e = &entries[(first + count) % BLACKBOX_MAX_FRAMES];
+        count++;
+        e->offset = at;
+        e->meta = (blackbox_meta_t){
+            .seq = next_seq++,
+            .t_us = esp_timer_get_time(),
+            .motor_steps = tag->motor_steps,
+            .pos = tag->pos,
+            .state = state,
+            .t_max = fp_deci(t_max),
+            .bearing = fp_cdeg(bearing),
+            .len = len,
+        };
+        memcpy(ring + at, coded, len);
+        write_pos = at + len;
+    }
+    if (state >= BLACKBOX_TRIGGER_STATE) {
+        if (armed) start_dump();
+        armed = false;
+    } else {
+        armed = true;
+    }
+    bool wake = dumping;                // post-trigger frames for the task
+    xSemaphoreGive(lock);
+
+    if (wake) xTaskNotifyGive(task);
+    perf_probe(PERF_blackbox, p);
+}
+
+// dumps what's in the ring now and the next BLACKBOX_POST_FRAMES, FP_CMD_BLACKBOX
+void blackbox_trigger(void) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    start_dump();
+    xSemaphoreGive(lock);
+    xTaskNotifyGive(task);
+}
+
+// true while an incident is going out over the radio; the frame stream stands down meanwhile,
+// the dump carries the same frames. Read without the lock, a frame either way doesn't matter.
+bool blackbox_sending(void) {
+    #ifdef BLACKBOX_TO_RADIO
+    return dumping;
+    #else
+    return false;
+    #endif
+}
+
+// the frame with sequence number seq, if it's in the ring
+static const entry_t *find(uint32_t seq) {
+    if (count == 0) return NULL;
+    uint32_t oldest = entries[first].meta.seq;
+    if (seq < oldest || seq - oldest >= (uint32_t)count) return NULL;
+    return &entries[(first + (seq - oldest)) % BLACKBOX_MAX_FRAMES];
+}
+
+// incident numbers carry on across reboots, so the files of the last one aren't the first to go
+static uint32_t next_incident(void) {
+    nvs_handle_t nvs;
+    uint32_t n = 0;
+    if (nvs_open("blackbox", NVS_READWRITE, &nvs) != ESP_OK) return 0;
+    nvs_get_u32(nvs, "incident", &n);
+    nvs_set_u32(nvs, "incident", n + 1);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+    return n;
+}
+
+#ifdef BLACKBOX_TO_RADIO
+// sends one frame as FP_MSG_BLACKBOX fragments, paced to stay under the reciever's rate limit
+static void send_frame(uint32_t incident, uint8_t frame, const blackbox_meta_t *m, int64_t t0_us) {
+    uint8_t buf[FP_MAX_PAYLOAD];
+    fp_blackbox_t *frag = (fp_blackbox_t *)buf;
+    int frags = (m->len + FP_BLACKBOX_MAX_DATA - 1) / FP_BLACKBOX_MAX_DATA;
+    for (int i = 0; i < frags; i++) {
+        int start = i * FP_BLACKBOX_MAX_DATA;
+        int n = m->len - start;
+        if (n > (int)FP_BLACKBOX_MAX_DATA) n = FP_BLACKBOX_MAX_DATA;
+        size_t len = sizeof(fp_blackbox_t) + n;
+
+        frag->incident = incident;
+        frag->frame = frame;
+        frag->t_ms = (m->t_us - t0_us) / 1000;
+        frag->motor_steps = m->motor_steps;
+        frag->pos = m->pos;
+        frag->state = m->state;
+        frag->t_max = m->t_max;
+        frag->bearing = m->bearing;
+        frag->index = i;
+        frag->count = frags;
+        frag->crc = 0;
+        memcpy(frag->data, sending + start, n);
+        frag->crc = fp_crc16(frag, len);
+        wireless_send_wait(FP_MSG_BLACKBOX, frag, len, pdMS_TO_TICKS(1000));
+        vTaskDelay(pdMS_TO_TICKS(1000 / BLACKBOX_RADIO_MSGS_PER_S));
+    }
+}
+#endif
+
+#ifdef BLACKBOX_TO_FLASH
+static FILE *open_file(uint32_t incident, int64_t t0_us) {
+    char path[40];
+    if (!flash) return NULL;
+    sprintf(path, BLACKBOX_MOUNT "/inc%u.bin", (unsigned)(incident % BLACKBOX_MAX_FILES));
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        DLOG(DLOG_WARN, "blackbox: can't open the incident file, radio only\n");
+        return NULL;
+    }
+    blackbox_file_t header = {
+        .magic = BLACKBOX_FILE_MAGIC,
+        .incident = incident,
+        .trigger_us = t0_us,
+    };
+    fwrite(&header, sizeof(header), 1, file);
+    return file;
+}
+#endif
+
+// Sends the frozen frames oldest first, then each post-trigger frame as it comes in. Frames
+// are copied out under the lock and sent without it, so the alert stage never waits on I/O.
+static void dump(void) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    int64_t t0_us = trigger_us;
+    uint32_t trigger_seq = last_seq - BLACKBOX_POST_FRAMES;
+    uint32_t dropped_before = dropped;
+    xSemaphoreGive(lock);
+
+    uint32_t incident = next_incident();
+    uint32_t frames = 0;
+    uint32_t post = 0;
+    #ifdef BLACKBOX_TO_FLASH
+    FILE *file = open_file(incident, t0_us);
+    #endif
+    DLOG(DLOG_WARN, "blackbox: incident %u, dumping\n", (unsigned)incident);
+    while (1) {
+        blackbox_meta_t meta;
+        xSemaphoreTake(lock, portMAX_DELAY);
+        if (send_seq > last_seq) {
+            dumping = false;
+            xSemaphoreGive(lock);
+            break;
+        }
+        const entry_t *e = find(send_seq);
+        if (e) {
+            meta = e->meta;
+            memcpy(sending, ring + e->offset, meta.len);
+            send_seq = meta.seq + 1;
+        }
+        xSemaphoreGive(lock);
+
+        if (e == NULL) {
+            // the post-trigger frames arrive as they're taken, blackbox_add wakes us for each
+            if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BLACKBOX_POST_TIMEOUT_MS)) == 0) {
+                xSemaphoreTake(lock, portMAX_DELAY);
+                dumping = false;
+                xSemaphoreGive(lock);
+                break;
+            }
+            continue;
+        }
+        #ifdef BLACKBOX_TO_FLASH
+        if (file) {
+            fwrite(&meta, sizeof(meta), 1, file);
+            fwrite(sending, 1, meta.len, file);
+            fflush(file);           // whatever made it out survives a reset halfway through
+        }
+        #endif
+        #ifdef BLACKBOX_TO_RADIO
+        send_frame(incident, frames, &meta, t0_us);
+        #endif
+        frames++;
+        if (meta.seq > trigger_seq) post++;
+    }
+    #ifdef BLACKBOX_TO_FLASH
+    if (file) fclose(file);
+    #endif
+    xSemaphoreTake(lock, portMAX_DELAY);
+    uint32_t lost = dropped - dropped_before;
+    xSemaphoreGive(lock);
+    DLOG(DLOG_WARN, "blackbox: incident %u done, %u frames (%u after the alarm), %u dropped meanwhile\n",
+         (unsigned)incident, (unsigned)frames, (unsigned)post, (unsigned)lost);
+}
+
+static void blackbox_task(void *arg) {
+    #ifdef BLACKBOX_TO_FLASH
+    // mounting (and formatting, the first time) takes a while, so it's done here and not at boot
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = BLACKBOX_MOUNT,
+        .partition_label = BLACKBOX_PARTITION,
+        .format_if_mount_failed = true,
+    };
+    esp_err_t err = esp_vfs_littlefs_register(&conf);
+    flash = err == ESP_OK;
+    if (!flash) DLOG(DLOG_WARN, "blackbox: no flash (%s), radio only\n", esp_err_to_name(err));
+    #endif
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (dumping) dump();
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "fire_protocol.h"
+#include "scan.h"
+
+// Black box: what the sensor saw in the run-up to an alarm.
+//
+// Every frame that comes out of the pipeline is compressed (a lossless thermal_codec keyframe,
+// ~600 bytes, so each one decodes without the ones before it and the oldest can be thrown
+// away) and copied into a RAM ring together with its time, scan position and motor steps.
+// That's all that happens in normal running: no radio, no flash.
+//
+// When a frame comes in at BLACKBOX_TRIGGER_STATE or worse (or the reciever sends
+// FP_CMD_BLACKBOX), the newest BLACKBOX_PRE_BYTES of the ring are frozen and a low priority
+// task sends them oldest first, followed by the next BLACKBOX_POST_FRAMES. They go to the reciever as
+// FP_MSG_BLACKBOX, and with BLACKBOX_TO_FLASH also into a file on the "blackbox" littlefs
+// partition, so the run-up survives the node burning down or losing the radio. New frames
+// keep going into the ring while that happens, into whatever space was already sent; if
+// there is none they're dropped (and counted) rather than overwrite the incident.
+//
+// The alarm has to clear (a frame below BLACKBOX_TRIGGER_STATE) before it can trigger again.
+#define BLACKBOX_BUDGET_BYTES (48 * 1024)   // coded frames, ~80 of them, ~40 s at full rate
+#define BLACKBOX_PRE_BYTES (32 * 1024)      // frozen on a trigger (~25 s), the rest is for the post frames
+#define BLACKBOX_MAX_FRAMES 128             // index entries, only matters if frames get small
+#define BLACKBOX_POST_FRAMES 20             // after the trigger, ~10 s
+#define BLACKBOX_MAX_ERROR 0                // tenths of a degree, 0 = lossless
+#define BLACKBOX_TRIGGER_STATE FP_STATE_WARNING
+
+#define BLACKBOX_TO_RADIO
+#define BLACKBOX_TO_FLASH                   // needs the "blackbox" partition in partitions.csv
+#define BLACKBOX_MOUNT "/blackbox"
+#define BLACKBOX_PARTITION "blackbox"
+#define BLACKBOX_MAX_FILES 8                // incidents kept on flash, the oldest is overwritten
+// Budgeted against everything the node sends while alarmed, not just the dump. The reciever
+// allows 20 bulk messages a second (panorama, black box and frame fragments share that) and
+// 20 of everything else, alerts excepted. The frame stream pauses while a dump is going out
+// (blackbox_sending), so the dump's 10 leave room for a panorama request; status, telemetry
+// and heartbeats are ~3 a second against the other bucket.
+#define BLACKBOX_RADIO_MSGS_PER_S 10
+#define BLACKBOX_POST_TIMEOUT_MS 10000      // stop waiting for post-trigger frames after this
+
+#define BLACKBOX_TASK_STACK 4352    // 256 of it is for wireless_send's copy
+#define BLACKBOX_TASK_PRIORITY 2            // below the alert stage, above dlog
+
+// what the ring holds about each frame, also the header of each frame in the flash file
+typedef struct __attribute__((packed)) {
+    uint32_t seq;                   // frames stored since boot
+    int64_t t_us;                   // esp_timer time it was taken
+    int32_t motor_steps;
+    int8_t pos;
+    uint8_t state;                  // fp_state_t
+    int16_t t_max;                  // tenths of a degree
+    uint16_t bearing;               // hundredths of a degree
+    uint16_t len;                   // coded bytes that follow
+} blackbox_meta_t;
+
+// A flash file is one blackbox_file_t, then each frame's blackbox_meta_t and its len coded bytes.
+#define BLACKBOX_FILE_MAGIC 0x31424246      // "FBB1"
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t incident;              // counts up across reboots (NVS "blackbox"/"incident")
+    int64_t trigger_us;
+} blackbox_file_t;
+
+// Function Declarations
+esp_err_t blackbox_init(void);
+void blackbox_add(const float *image, const scan_tag_t *tag, float bearing, float t_max, uint8_t state);
+void blackbox_trigger(void);
+bool blackbox_sending(void);
+
+#endif // BLACKBOX_H
@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "wireless_esp.h"
+#include "main.h"
+#include "boot.h"
+
+typedef struct {
+    boot_lane_fn_t fn;
+    StackType_t stack[BOOT_LANE_STACK];
+    StaticTask_t tcb;
+} boot_lane_t;
+
+static boot_record_t records[BOOT_MAX_STEPS];
+static int num_records = 0;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;     // lanes add records at the same time
+static boot_lane_t lanes[BOOT_MAX_LANES];
+static int num_lanes = 0;
+static SemaphoreHandle_t lanes_done;
+static StaticSemaphore_t lanes_done_buf;
+
+static boot_record_t *new_record(const char *name) {
+    boot_record_t *r = NULL;
+    portENTER_CRITICAL(&lock);
+    if (num_records < BOOT_MAX_STEPS) r = &records[num_records++];
+    portEXIT_CRITICAL(&lock);
+    if (r) {
+        r->name = name;
+        strncpy(r->lane, pcTaskGetName(NULL), sizeof(r->lane) - 1);
+        r->lane[sizeof(r->lane) - 1] = '\0';
+    }
+    return r;
+}
+
+// runs fn in the calling task and records how long it took and what it returned
+esp_err_t boot_step(const char *name, boot_fn_t fn) {
+    boot_record_t *r = new_record(name);
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = fn();
+    if (r) {
+        r->start_us = start;
+        r->end_us = esp_timer_get_time();
+        r->err = err;
+    }
+    return err;
+}
+
+// a point in time rather than a step, e.g. the first frame out of the pipeline
+void boot_mark(const char *name) {
+    boot_record_t *r = new_record(name);
+    if (r) {
+        r->start_us = r->end_us = esp_timer_get_time();
+        r->err = ESP_OK;
+    }
+}
+
+static void lane_task(void *arg) {
+    boot_lane_t *lane = arg;
+    lane->fn();
+    xSemaphoreGive(lanes_done);
+    vTaskDelete(NULL);
+}
+
+// Runs fn in a task of its own and returns straight away. Lanes are for bring-up only, they
+// end when fn returns; past BOOT_MAX_LANES fn just runs here.
+void boot_spawn(const char *name, boot_lane_fn_t fn) {
+    if (lanes_done == NULL) lanes_done = xSemaphoreCreateCountingStatic(BOOT_MAX_LANES, 0, &lanes_done_buf);
+    if (num_lanes >= BOOT_MAX_LANES) {
+        fn();
+        return;
+    }
+    boot_lane_t *lane = &lanes[num_lanes++];
+    lane->fn = fn;
+    xTaskCreateStatic(lane_task, name, BOOT_LANE_STACK, lane, BOOT_LANE_PRIORITY, lane->stack, &lane->tcb);
+}
+
+// waits until every lane started with boot_spawn has finished
+void boot_join(void) {
+    for (int i = 0; i < num_lanes; i++) xSemaphoreTake(lanes_done, portMAX_DELAY);
+    num_lanes = 0;
+}
+
+static const char *reset_reason_name(esp_reset_reason_t reason) {
+    switch (reason) {
+        case ESP_RST_POWERON: return "power on";
+        case ESP_RST_EXT: return "reset pin";
+        case ESP_RST_SW: return "restart";
+        case ESP_RST_PANIC: return "panic";
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT: return "watchdog";
+        case ESP_RST_DEEPSLEEP: return "deep sleep";
+        case ESP_RST_BROWNOUT: return "brownout";
+        default: return "unknown";
+    }
+}
+
+// Prints the timeline (start, length, lane) in the order things started, and sends the
+// headline to the reciever so resets show up there with how long we were blind.
+void boot_print(void) {
+    char message[160];
+    boot_record_t sorted[BOOT_MAX_STEPS];
+    portENTER_CRITICAL(&lock);
+    int n = num_records;
+    memcpy(sorted, records, n * sizeof(boot_record_t));
+    portEXIT_CRITICAL(&lock);
+    for (int i = 1; i < n; i++) {
+        boot_record_t r = sorted[i];
+        int j = i;
+        for (; j > 0 && sorted[j - 1].start_us > r.start_us; j--) sorted[j] = sorted[j - 1];
+        sorted[j] = r;
+    }
+
+    const boot_record_t *last = NULL;
+    for (int i = 0; i < n; i++) {
+        if (!last || sorted[i].end_us >= last->end_us) last = &sorted[i];
+    }
+    sprintf(message, "boot after %s: %s at %lld ms\n", reset_reason_name(esp_reset_reason()),
+            last ? last->name : "nothing yet", (long long)((last ? last->end_us : esp_timer_get_time()) / 1000));
+    print_msg(message);
+    wireless_send_text(message);
+    for (int i = 0; i < n; i++) {
+        const boot_record_t *r = &sorted[i];
+        sprintf(message, "  at %7.1f ms  %7.1f ms  %-10s %s%s%s\n", r->start_us / 1000.0f,
+                (r->end_us - r->start_us) / 1000.0f, r->lane, r->name, r->err == ESP_OK ? "" : " FAILED: ",
+                r->err == ESP_OK ? "" : esp_err_to_name(r->err));
+        print_msg(message);
+    }
+}
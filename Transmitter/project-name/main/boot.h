@@ -0,0 +1,40 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Boot sequencing: bring-up steps that don't depend on each other run in parallel lanes
+// (one FreeRTOS task each) instead of one after the other, and every step is timed so the
+// boot timeline can be printed once the first frame has been through the pipeline.
+//
+//   boot_step("nvs", init_nvs);           runs now, in the calling task
+//   boot_spawn("radio", bring_up_radio);  runs in its own task, which calls boot_step itself
+//   boot_join();                          waits for every spawned lane
+//
+// Times are from esp_timer, which starts just before app_main -- the ROM and bootloader
+// (~300 ms on a cold start) come before it and aren't in the timeline.
+#define BOOT_MAX_STEPS 24
+#define BOOT_MAX_LANES 2
+#define BOOT_LANE_STACK 4352         // lanes send text, 256 of it is for wireless_send
+#define BOOT_LANE_PRIORITY 5
+
+typedef esp_err_t (*boot_fn_t)(void);
+typedef void (*boot_lane_fn_t)(void);
+
+typedef struct {
+    const char *name;
+    char lane[12];
+    int64_t start_us;
+    int64_t end_us;
+    esp_err_t err;
+} boot_record_t;
+
+// Function Declarations
+esp_err_t boot_step(const char *name, boot_fn_t fn);
+void boot_spawn(const char *name, boot_lane_fn_t fn);
+void boot_join(void);
+void boot_mark(const char *name);
+void boot_print(void);
+
+#endif // BOOT_H
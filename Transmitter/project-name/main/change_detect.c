@@ -0,0 +1,87 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "main.h"
+#include "change_detect.h"
+
+typedef struct {
+    bool valid;
+    uint8_t visits;
+    float ta;                                   // ambient when the reference was taken
+    int32_t signature[MLX90640_NUM_TILES];      // sum of raw pixel words per tile
+    int32_t pending[MLX90640_NUM_TILES];        // signature of the frame being processed
+    float pending_ta;
+    float temps[NUM_ROWS*NUM_COLS];             // last calibrated image at this position
+} view_ref_t;
+
+static view_ref_t views[CD_NUM_POSITIONS];
+static uint32_t stat_tiles_total = 0;
+static uint32_t stat_tiles_skipped = 0;
+
+void change_detect_init(void) {
+    memset(views, 0, sizeof(views));
+    stat_tiles_total = 0;
+    stat_tiles_skipped = 0;
+}
+
+// Compares the raw frame against the reference for this position and returns a mask of the
+// tiles that need calibrating. Work is done in the raw ADC domain on the pyramid's tile sums,
+// the MLX per-pixel offsets are constant so they cancel out in the difference.
+// The reference only moves forward for tiles that actually get recalculated (see
+// change_detect_store), so slow drift still adds up until it crosses the threshold instead of
+// sneaking through one frame at a time, and a changed tile we chose not to calculate keeps
+// showing up as changed.
+uint64_t change_detect_update(int pos, const pyramidMLX90640 *pyramid, float ta) {
+    if (pos < 0 || pos >= CD_NUM_POSITIONS) {
+        return MLX90640_ALL_TILES;
+    }
+    view_ref_t *v = &views[pos];
+    memcpy(v->pending, pyramid->tileSum, sizeof(v->pending));
+    v->pending_ta = ta;
+
+    uint64_t changed = 0;
+    bool full = !v->valid || v->visits + 1 >= CD_REFRESH_VISITS
+                || ta - v->ta > CD_TA_THRESHOLD || v->ta - ta > CD_TA_THRESHOLD;
+    if (full) {
+        changed = MLX90640_ALL_TILES;
+    } else {
+        for (int t = 0; t < MLX90640_NUM_TILES; t++) {
+            if (abs(pyramid->tileSum[t] - v->signature[t]) > CD_TILE_THRESHOLD) {
+                changed |= 1ULL << t;
+            }
+        }
+    }
+    v->visits++;
+    return changed;
+}
+
+// copies the cached temperatures for this position into image (if we have any),
+// call before calculating the changed tiles on top of it
+void change_detect_restore(int pos, float *image) {
+    if (pos < 0 || pos >= CD_NUM_POSITIONS || !views[pos].valid) return;
+    memcpy(image, views[pos].temps, sizeof(views[pos].temps));
+}
+
+// caches the image for this position and moves the reference forward for the tiles that
+// were calculated; a full calculation also resets the ambient and refresh counter
+void change_detect_store(int pos, const float *image, uint64_t calculated) {
+    if (pos < 0 || pos >= CD_NUM_POSITIONS) return;
+    view_ref_t *v = &views[pos];
+    memcpy(v->temps, image, sizeof(v->temps));
+    for (int t = 0; t < MLX90640_NUM_TILES; t++) {
+        if ((calculated >> t) & 1) v->signature[t] = v->pending[t];
+    }
+    if (calculated == MLX90640_ALL_TILES) {
+        v->valid = true;
+        v->visits = 0;
+        v->ta = v->pending_ta;
+    }
+
+    stat_tiles_total += MLX90640_NUM_TILES;
+    stat_tiles_skipped += MLX90640_NUM_TILES - __builtin_popcountll(calculated);
+}
+
+void change_detect_stats(uint32_t *tiles_total, uint32_t *tiles_skipped) {
+    *tiles_total = stat_tiles_total;
+    *tiles_skipped = stat_tiles_skipped;
+}
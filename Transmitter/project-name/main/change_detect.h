@@ -0,0 +1,23 @@
+#ifndef CHANGE_DETECT_H
+#define CHANGE_DETECT_H
+
+#include <stdint.h>
+#include "main.h"
+#include "MLX90640_API.h"
+#include "MLX90640_Pyramid.h"
+
+// Per scan position reference of what the view looked like last time, so frames that
+// come back to a position we've already seen only get recalibrated where they changed.
+#define CD_NUM_POSITIONS (SCAN_MAX_POS - SCAN_MIN_POS + 1)
+#define CD_TILE_THRESHOLD 64        // raw counts, summed over the 16 pixels of a tile
+#define CD_TA_THRESHOLD 0.5f        // ambient drift (C) that forces a full recalculation
+#define CD_REFRESH_VISITS 16        // recalculate everything every this many visits anyway
+
+// Function Declarations
+void change_detect_init(void);
+uint64_t change_detect_update(int pos, const pyramidMLX90640 *pyramid, float ta);
+void change_detect_restore(int pos, float *image);
+void change_detect_store(int pos, const float *image, uint64_t calculated);
+void change_detect_stats(uint32_t *tiles_total, uint32_t *tiles_skipped);
+
+#endif // CHANGE_DETECT_H
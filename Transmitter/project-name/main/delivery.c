@@ -0,0 +1,245 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_log.h"
+#include "fire_protocol.h"
+#include "delivery.h"
+#include "perf.h"
+#include "frame_stream.h"
+
+// ESP-NOW calls the send callback once per esp_now_send, in order, with the MAC level ack
+// result from the peer. With only one packet in the air at a time the callback always
+// belongs to the in_flight slot, so we know exactly which message (by seq) got through.
+// The callback runs in the wifi task and the retry timer in the esp_timer task, so slot
+// bookkeeping happens under a spinlock and esp_now_send is only called from pump().
+
+typedef struct {
+    bool used;
+    uint8_t prio;               // delivery_prio_t
+    uint8_t tries;              // sends so far
+    uint8_t len;
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    int64_t queued_us;          // when it went into the tx_queue, for latency
+    int64_t next_try_us;        // not before this (backoff)
+    uint32_t order;             // submit order, oldest first within a priority
+    uint8_t packet[FP_MAX_PACKET];
+} slot_t;
+
+static const char *TAG = "DELIVERY";
+static const uint8_t max_tries[] = { DELIVERY_TRIES_CRITICAL, DELIVERY_TRIES_NORMAL, DELIVERY_TRIES_BULK };
+
+static slot_t slots[DELIVERY_SLOTS];
+static int in_flight = -1;
+static uint32_t submit_order = 0;
+static delivery_stats_t stats;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t retry_timer;
+
+static void pump(void);
+
+static void retry_timer_cb(void *arg) {
+    pump();
+}
+
+// wakes pump() up after delay_us, or sooner if it is already armed for earlier
+static void arm_timer(int64_t delay_us) {
+    if (delay_us < 50) delay_us = 50;   // esp_timer's minimum useful one-shot
+    esp_timer_stop(retry_timer);
+    esp_timer_start_once(retry_timer, delay_us);
+}
+
+// 2^tries * base, capped, then scaled by a random 0.5-1.5 so two detectors that collided
+// once don't keep colliding
+static int64_t backoff_us(int tries) {
+    int64_t d = (int64_t)DELIVERY_BACKOFF_BASE_US << (tries > 4 ? 4 : tries - 1);
+    if (d > DELIVERY_BACKOFF_MAX_US) d = DELIVERY_BACKOFF_MAX_US;
+    return d / 2 + (int64_t)(esp_random() % (uint32_t)(d + 1));
+}
+
+static uint16_t packet_seq(const slot_t *s) {
+    return ((const fp_header_t *)s->packet)->seq;
+}
+
+// one of our own streamed fragments (not one we forward); losing it breaks the frames after it
+static bool is_own_fragment(const slot_t *s) {
+    const fp_header_t *h = (const fp_header_t *)s->packet;
+    return h->type == FP_MSG_FRAME_FRAG && !(h->flags & FP_FLAG_RELAYED);
+}
+
+static void record_latency(uint8_t prio, int64_t us) {
+    delivery_latency_t *l = &stats.latency[prio];
+    int b = 0;
+    while (b < DELIVERY_LATENCY_BUCKETS - 1 && us >= (1000LL << b)) b++;
+    l->hist[b]++;
+    if (us > l->max_us) l->max_us = (uint32_t)us;
+}
+
+// Picks the best ready slot (lowest prio number, then oldest) and sends it. If nothing is
+// ready yet, arms the timer for the earliest backoff to run out.
+static void pump(void) {
+    while (1) {
+        int64_t now = esp_timer_get_time();
+        int best = -1;
+        int64_t earliest = INT64_MAX;
+
+        taskENTER_CRITICAL(&lock);
+        if (in_flight >= 0) {
+            taskEXIT_CRITICAL(&lock);
+            return;
+        }
+        for (int i = 0; i < DELIVERY_SLOTS; i++) {
+            slot_t *s = &slots[i];
+            if (!s->used) continue;
+            if (s->next_try_us > now) {
+                if (s->next_try_us < earliest) earliest = s->next_try_us;
+                continue;
+            }
+            if (best < 0 || s->prio < slots[best].prio ||
+                (s->prio == slots[best].prio && (int32_t)(s->order - slots[best].order) < 0)) {
+                best = i;
+            }
+        }
+        if (best >= 0) {
+            in_flight = best;
+            slots[best].tries++;
+            stats.attempts++;
+            if (slots[best].tries > 1) stats.retries++;
+        }
+        taskEXIT_CRITICAL(&lock);
+
+        if (best < 0) {
+            if (earliest != INT64_MAX) arm_timer(earliest - now);
+            return;
+        }
+
+        // the slot can't change under us while it's in flight
+        slot_t *s = &slots[best];
+        perf_mark_t p = perf_now();
+        esp_err_t err = esp_now_send(s->mac, s->packet, s->len);
+        perf_probe(PERF_radio_send, p);
+        if (err == ESP_OK) {
+            return;     // delivery_on_sent takes it from here
+        }
+
+        // never made it onto the air (wifi queue full etc.), treat it as a failed attempt
+        delivery_on_sent(ESP_NOW_SEND_FAIL);
+    }
+}
+
+void delivery_init(void) {
+    const esp_timer_create_args_t args = {
+        .callback = retry_timer_cb,
+        .name = "delivery",
+    };
+    memset(slots, 0, sizeof(slots));
+    memset(&stats, 0, sizeof(stats));
+    in_flight = -1;
+    esp_timer_create(&args, &retry_timer);
+}
+
+// Copies the packet into a free slot and kicks the sender. When the table is full an alert
+// evicts the newest waiting packet of a lower priority, which is lost (counted in dropped);
+// anything else gets ESP_ERR_NO_MEM and stays with the caller, who tries again later, so it
+// isn't counted.
+esp_err_t delivery_submit(const uint8_t *mac, const uint8_t *packet, size_t len, delivery_prio_t prio, int64_t queued_us) {
+    if (len > FP_MAX_PACKET) return ESP_ERR_INVALID_SIZE;
+
+    bool lost_fragment = false;
+    taskENTER_CRITICAL(&lock);
+    int slot = -1;
+    for (int i = 0; i < DELIVERY_SLOTS && slot < 0; i++) {
+        if (!slots[i].used) slot = i;
+    }
+    if (slot < 0) {
+        for (int i = 0; i < DELIVERY_SLOTS; i++) {
+            if (i == in_flight || slots[i].prio <= prio) continue;
+            if (slot < 0 || slots[i].prio > slots[slot].prio ||
+                (slots[i].prio == slots[slot].prio && (int32_t)(slots[i].order - slots[slot].order) > 0)) {
+                slot = i;
+            }
+        }
+        if (slot >= 0) {
+            stats.dropped++;                // the evicted packet
+            lost_fragment = is_own_fragment(&slots[slot]);
+        }
+    }
+    if (slot < 0) {
+        taskEXIT_CRITICAL(&lock);
+        return ESP_ERR_NO_MEM;
+    }
+    slot_t *s = &slots[slot];
+    s->used = true;
+    s->prio = prio;
+    s->tries = 0;
+    s->len = (uint8_t)len;
+    memcpy(s->mac, mac, ESP_NOW_ETH_ALEN);
+    memcpy(s->packet, packet, len);
+    s->queued_us = queued_us;
+    s->next_try_us = 0;
+    s->order = submit_order++;
+    taskEXIT_CRITICAL(&lock);
+
+    if (lost_fragment) frame_stream_lost();
+    pump();
+    return ESP_OK;
+}
+
+// Called from on_data_sent with the result for the in_flight packet. Success frees the slot,
+// failure either schedules a retry or gives up once the packet is out of tries.
+void delivery_on_sent(esp_now_send_status_t status) {
+    int64_t now = esp_timer_get_time();
+    bool gave_up = false;
+    bool lost_fragment = false;
+    uint16_t seq = 0;
+
+    taskENTER_CRITICAL(&lock);
+    if (in_flight < 0) {
+        taskEXIT_CRITICAL(&lock);
+        return;     // someone else's send
+    }
+    slot_t *s = &slots[in_flight];
+    in_flight = -1;
+    seq = packet_seq(s);
+    if (status == ESP_NOW_SEND_SUCCESS) {
+        stats.delivered++;
+        record_latency(s->prio, now - s->queued_us);
+        s->used = false;
+    } else if (s->tries >= max_tries[s->prio]) {
+        stats.gave_up++;
+        gave_up = true;
+        lost_fragment = is_own_fragment(s);
+        s->used = false;
+    } else {
+        s->next_try_us = now + backoff_us(s->tries);
+    }
+    taskEXIT_CRITICAL(&lock);
+
+    if (gave_up) {
+        ESP_LOGW(TAG, "gave up on seq %u", seq);
+    }
+    if (lost_fragment) frame_stream_lost();
+    // don't send from the wifi task, let the timer task do it
+    arm_timer(0);
+}
+
+static void work_out_p99(delivery_latency_t *l) {
+    uint32_t total = 0, seen = 0;
+    for (int b = 0; b < DELIVERY_LATENCY_BUCKETS; b++) total += l->hist[b];
+    l->p99_us = 0;
+    for (int b = 0; b < DELIVERY_LATENCY_BUCKETS && total; b++) {
+        seen += l->hist[b];
+        if (seen * 100ULL >= total * 99ULL) {
+            l->p99_us = (b == DELIVERY_LATENCY_BUCKETS - 1) ? l->max_us : (1000U << b);
+            break;
+        }
+    }
+}
+
+// snapshot of the counters, with the 99th percentiles worked out from the histograms
+void delivery_get_stats(delivery_stats_t *out) {
+    taskENTER_CRITICAL(&lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&lock);
+    for (int p = 0; p < DELIVERY_NUM_PRIOS; p++) work_out_p99(&out->latency[p]);
+}
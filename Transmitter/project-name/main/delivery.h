@@ -0,0 +1,49 @@
+#ifndef DELIVERY_H
+#define DELIVERY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_now.h"
+
+// Delivery layer between wireless_send() and esp_now_send().
+// Keeps exactly one packet in the air, matches each send callback to that packet, and
+// retries failed ones with jittered exponential backoff -- a lot for alerts, once for
+// routine traffic. Pending packets go out highest priority first.
+#define DELIVERY_SLOTS 16                  // room for a whole streamed frame plus status traffic
+#define DELIVERY_BACKOFF_BASE_US 2000       // first retry after ~2 ms ...
+#define DELIVERY_BACKOFF_MAX_US 16000       // ... doubling up to ~16 ms (+-50% jitter)
+#define DELIVERY_TRIES_CRITICAL 10          // ~120 ms worth of retries for an alert
+#define DELIVERY_TRIES_NORMAL 2
+#define DELIVERY_TRIES_BULK 3
+#define DELIVERY_LATENCY_BUCKETS 12         // 1 ms buckets doubling: <1, <2, <4 ... ms
+
+typedef enum {
+    DELIVERY_CRITICAL = 0,      // alerts
+    DELIVERY_NORMAL = 1,        // status, telemetry, text
+    DELIVERY_BULK = 2,          // panorama dumps and other large transfers
+    DELIVERY_NUM_PRIOS
+} delivery_prio_t;
+
+// queue -> ack time of one priority's packets, so bulk traffic can't hide how long alerts take
+typedef struct {
+    uint32_t max_us;
+    uint32_t p99_us;            // upper edge of the bucket holding the 99th percentile
+    uint32_t hist[DELIVERY_LATENCY_BUCKETS];
+} delivery_latency_t;
+
+typedef struct {
+    uint32_t delivered;         // packets acked
+    uint32_t attempts;          // esp_now_send calls, including retries
+    uint32_t retries;
+    uint32_t gave_up;           // ran out of tries
+    uint32_t dropped;           // evicted from a full table by an alert, never sent
+    delivery_latency_t latency[DELIVERY_NUM_PRIOS];     // by delivery_prio_t
+} delivery_stats_t;
+
+// Function Declarations
+void delivery_init(void);
+esp_err_t delivery_submit(const uint8_t *mac, const uint8_t *packet, size_t len, delivery_prio_t prio, int64_t queued_us);
+void delivery_on_sent(esp_now_send_status_t status);
+void delivery_get_stats(delivery_stats_t *stats);
+
+#endif // DELIVERY_H
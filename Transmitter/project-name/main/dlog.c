@@ -0,0 +1,171 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "main.h"
+#include "dlog.h"
+
+// One log line as recorded. seq says whose turn the slot is (bounded MPMC ring as in Vyukov's
+// queue): a writer may fill it when seq == its ticket, the reader may take it when
+// seq == ticket + 1, and the reader hands it back for the next lap with ticket + ring size.
+typedef struct {
+    atomic_uint seq;
+    const char *fmt;
+    uint16_t nargs;
+    uint16_t types;                         // 2 bits per argument, dlog_type_t
+    uintptr_t vals[DLOG_MAX_ARGS];
+} dlog_record_t;
+
+static dlog_record_t ring[DLOG_RING_SIZE];
+static atomic_uint head;                    // next ticket for writers
+static unsigned tail;                       // reader side, under the reader mutex
+static SemaphoreHandle_t reader;            // dlog_task or dlog_flush, writers never take it
+static StaticSemaphore_t reader_buf;
+static atomic_uint dropped;
+
+static StackType_t task_stack[DLOG_TASK_STACK];
+static StaticTask_t task_tcb;
+
+static void dlog_task(void *arg);
+
+void dlog_init(void) {
+    for (unsigned i = 0; i < DLOG_RING_SIZE; i++) atomic_init(&ring[i].seq, i);
+    atomic_init(&head, 0);
+    atomic_init(&dropped, 0);
+    tail = 0;
+    reader = xSemaphoreCreateMutexStatic(&reader_buf);
+    xTaskCreateStaticPinnedToCore(dlog_task, "dlog", DLOG_TASK_STACK, NULL, DLOG_TASK_PRIORITY, task_stack, &task_tcb, 0);
+}
+
+// Safe from any task or ISR on either core, never waits: if the slot it would need hasn't
+// been printed yet the ring is full and the line is dropped.
+void dlog_write(const char *fmt, const dlog_arg_t *args, int nargs) {
+    unsigned pos = atomic_load_explicit(&head, memory_order_relaxed);
+    dlog_record_t *r;
+    while (1) {
+        r = &ring[pos & (DLOG_RING_SIZE - 1)];
+        int diff = (int)(atomic_load_explicit(&r->seq, memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&head, memory_order_relaxed);
+        }
+    }
+    r->fmt = fmt;
+    r->nargs = nargs;
+    uint16_t types = 0;
+    for (int i = 0; i < nargs; i++) {
+        types |= args[i].type << (2 * i);
+        r->vals[i] = args[i].bits;
+    }
+    r->types = types;
+    atomic_store_explicit(&r->seq, pos + 1, memory_order_release);
+}
+
+// formats one conversion (spec is "%...", conv its last character) with whatever the value
+// was recorded as
+static int format_one(char *out, int size, const char *spec, char conv, const dlog_arg_t *a) {
+    switch (conv) {
+        case 'd': case 'i':
+            return snprintf(out, size, spec, a->type == DLOG_T_FLOAT ? (int)a->f : (int)a->i);
+        case 'u': case 'x': case 'X': case 'o': case 'c':
+            return snprintf(out, size, spec, a->type == DLOG_T_FLOAT ? (unsigned)a->f : (unsigned)a->u);
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            return snprintf(out, size, spec, a->type == DLOG_T_FLOAT ? (double)a->f :
+                                             a->type == DLOG_T_UINT ? (double)a->u : (double)a->i);
+        case 's':
+            return snprintf(out, size, spec, a->type == DLOG_T_STR && a->s ? a->s : "?");
+        case 'p':
+            return snprintf(out, size, spec, (void *)(uintptr_t)a->u);
+        default:
+            return 0;
+    }
+}
+
+// printf for a recorded line: walks the format and hands each conversion to snprintf on its
+// own with the length modifiers taken out. Returns the length written (truncated to size).
+int dlog_format(const char *fmt, const dlog_arg_t *args, int nargs, char *out, int size) {
+    int n = 0, arg = 0;
+    char spec[16];
+    if (size <= 0) return 0;
+    while (*fmt && n < size - 1) {
+        if (*fmt != '%') {
+            out[n++] = *fmt++;
+            continue;
+        }
+        if (fmt[1] == '%') {
+            out[n++] = '%';
+            fmt += 2;
+            continue;
+        }
+        int len = 0;
+        spec[len++] = *fmt++;
+        while (*fmt && strchr("-+ #0123456789.", *fmt) && len < (int)sizeof(spec) - 2) spec[len++] = *fmt++;
+        while (*fmt && strchr("hlLqjzt", *fmt)) fmt++;
+        if (!*fmt) break;
+        char conv = *fmt++;
+        spec[len++] = conv;
+        spec[len] = '\0';
+        if (arg >= nargs) continue;
+        int w = format_one(out + n, size - n, spec, conv, &args[arg++]);
+        if (w > 0) n += (w < size - n) ? w : size - 1 - n;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+// prints the oldest recorded line, false when there's nothing to print
+static bool drain_one(void) {
+    dlog_record_t *r = &ring[tail & (DLOG_RING_SIZE - 1)];
+    if (atomic_load_explicit(&r->seq, memory_order_acquire) != tail + 1) return false;
+    dlog_arg_t args[DLOG_MAX_ARGS];
+    int nargs = r->nargs;
+    for (int i = 0; i < nargs; i++) {
+        args[i].type = (r->types >> (2 * i)) & 3;
+        args[i].bits = r->vals[i];
+    }
+    const char *fmt = r->fmt;
+    atomic_store_explicit(&r->seq, tail + DLOG_RING_SIZE, memory_order_release);
+    tail++;
+
+    char line[200];
+    dlog_format(fmt, args, nargs, line, sizeof(line));
+    print_msg(line);
+    return true;
+}
+
+static void dlog_task(void *arg) {
+    uint32_t reported = 0;
+    char message[60];
+    while (1) {
+        xSemaphoreTake(reader, portMAX_DELAY);
+        while (drain_one()) {}
+        xSemaphoreGive(reader);
+        uint32_t d = dlog_dropped();
+        if (d != reported) {
+            sprintf(message, "dlog: %lu lines dropped\n", (unsigned long)(d - reported));
+            print_msg(message);
+            reported = d;
+        }
+        vTaskDelay(pdMS_TO_TICKS(DLOG_DRAIN_MS));
+    }
+}
+
+// prints whatever is waiting right now from the calling task, for before a restart or a
+// long blocking step
+void dlog_flush(void) {
+    xSemaphoreTake(reader, portMAX_DELAY);
+    while (drain_one()) {}
+    xSemaphoreGive(reader);
+}
+
+uint32_t dlog_dropped(void) {
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
@@ -0,0 +1,97 @@
+#ifndef DLOG_H
+#define DLOG_H
+
+#include <stdint.h>
+
+// Deferred logging for the pipeline stages. DLOG doesn't format anything: it puts the
+// address of the format string (which is a literal, so it never changes and works as its ID)
+// and the raw argument values into a RAM ring, and a low priority task turns them into text
+// and writes them to the UART later. A call on the hot path is a compare-and-swap and a copy
+// of ~50 bytes instead of a vsprintf and a 115200 baud write.
+//
+// Rules that come with that:
+//   - at most DLOG_MAX_ARGS arguments, each one int sized or smaller, a float/double, or a
+//     string that stays around (literals, tracker_class_name...), never a local buffer
+//   - doubles are kept as float, 64-bit integers get cut to 32 bits (cast or scale first)
+//   - no '*' widths; length modifiers (%ld, %lld...) are fine to write but are ignored
+//
+// The ring is fixed size and never blocks, when the drain task falls behind new lines are
+// dropped and counted (dlog_dropped). Anything above DLOG_LEVEL compiles away completely.
+#define DLOG_ERROR 1
+#define DLOG_WARN 2
+#define DLOG_INFO 3
+#define DLOG_DEBUG 4
+
+#ifndef DLOG_LEVEL
+#define DLOG_LEVEL DLOG_INFO
+#endif
+
+#define DLOG_MAX_ARGS 8
+#define DLOG_RING_SIZE 64               // records, a power of 2
+#define DLOG_TASK_STACK 3072
+#define DLOG_TASK_PRIORITY 1            // below every pipeline stage
+#define DLOG_DRAIN_MS 20                // how often the task looks when the ring is empty
+
+typedef enum {
+    DLOG_T_INT,
+    DLOG_T_UINT,
+    DLOG_T_FLOAT,
+    DLOG_T_STR,
+} dlog_type_t;
+
+typedef struct {
+    uint32_t type;
+    union {
+        int32_t i;
+        uint32_t u;
+        float f;
+        const char *s;
+        uintptr_t bits;                 // all of it, for copying
+    };
+} dlog_arg_t;
+
+static inline dlog_arg_t dlog_int(int32_t v) { dlog_arg_t a = { .type = DLOG_T_INT, .i = v }; return a; }
+static inline dlog_arg_t dlog_uint(uint32_t v) { dlog_arg_t a = { .type = DLOG_T_UINT, .u = v }; return a; }
+static inline dlog_arg_t dlog_float(double v) { dlog_arg_t a = { .type = DLOG_T_FLOAT, .f = (float)v }; return a; }
+static inline dlog_arg_t dlog_str(const char *v) { dlog_arg_t a = { .type = DLOG_T_STR, .s = v }; return a; }
+static inline dlog_arg_t dlog_ptr(const void *v) { dlog_arg_t a = { .type = DLOG_T_UINT, .u = (uint32_t)(uintptr_t)v }; return a; }
+
+#define DLOG_ARG(x) _Generic((x), \
+    float: dlog_float, double: dlog_float, \
+    char *: dlog_str, const char *: dlog_str, \
+    unsigned char: dlog_uint, unsigned short: dlog_uint, unsigned int: dlog_uint, \
+    unsigned long: dlog_uint, unsigned long long: dlog_uint, \
+    void *: dlog_ptr, const void *: dlog_ptr, \
+    default: dlog_int)(x)
+
+// one DLOG_ARG per argument, 0 to DLOG_MAX_ARGS of them
+#define DLOG_EACH_0()
+#define DLOG_EACH_1(a) DLOG_ARG(a)
+#define DLOG_EACH_2(a, ...) DLOG_ARG(a), DLOG_EACH_1(__VA_ARGS__)
+#define DLOG_EACH_3(a, ...) DLOG_ARG(a), DLOG_EACH_2(__VA_ARGS__)
+#define DLOG_EACH_4(a, ...) DLOG_ARG(a), DLOG_EACH_3(__VA_ARGS__)
+#define DLOG_EACH_5(a, ...) DLOG_ARG(a), DLOG_EACH_4(__VA_ARGS__)
+#define DLOG_EACH_6(a, ...) DLOG_ARG(a), DLOG_EACH_5(__VA_ARGS__)
+#define DLOG_EACH_7(a, ...) DLOG_ARG(a), DLOG_EACH_6(__VA_ARGS__)
+#define DLOG_EACH_8(a, ...) DLOG_ARG(a), DLOG_EACH_7(__VA_ARGS__)
+#define DLOG_PICK(_0, _1, _2, _3, _4, _5, _6, _7, _8, name, ...) name
+#define DLOG_EACH(...) DLOG_PICK(_0, ##__VA_ARGS__, DLOG_EACH_8, DLOG_EACH_7, DLOG_EACH_6, DLOG_EACH_5, \
+                                 DLOG_EACH_4, DLOG_EACH_3, DLOG_EACH_2, DLOG_EACH_1, DLOG_EACH_0)(__VA_ARGS__)
+
+// DLOG(DLOG_INFO, "t_max=%.1f at %.1f deg\n", t_max, bearing);
+#define DLOG(level, fmt, ...) do { \
+        if ((level) <= DLOG_LEVEL) { \
+            const dlog_arg_t dlog_args_[] = { DLOG_EACH(__VA_ARGS__) }; \
+            _Static_assert(sizeof(dlog_args_) / sizeof(dlog_arg_t) <= DLOG_MAX_ARGS, "DLOG: too many arguments"); \
+            dlog_write("" fmt, dlog_args_, sizeof(dlog_args_) / sizeof(dlog_arg_t)); \
+        } \
+    } while (0)
+
+// Function Declarations
+void dlog_init(void);
+void dlog_write(const char *fmt, const dlog_arg_t *args, int nargs);
+int dlog_format(const char *fmt, const dlog_arg_t *args, int nargs, char *out, int size);
+void dlog_flush(void);
+uint32_t dlog_dropped(void);
+
+#endif // DLOG_H
@@ -0,0 +1,92 @@
+#include <string.h>
+#include "esp_timer.h"
+#include "main.h"
+#include "wireless_esp.h"
+#include "thermal_codec.h"
+#include "frame_stream.h"
+
+static bool streaming = false;
+static int64_t min_interval_us = (int64_t)(1e6f / FRAME_STREAM_MAX_FPS);
+static int64_t last_frame_us = 0;
+static uint16_t frame_id = 0;
+static volatile bool lost = false;     // set from the wifi/timer tasks, see frame_stream_lost
+static tc_encoder_t encoder;
+static int16_t cells[TC_CELLS];
+static uint8_t coded[TC_MAX_ENCODED];
+
+void frame_stream_init(void) {
+    tc_encoder_init(&encoder, FRAME_STREAM_KEYFRAME_INTERVAL, FRAME_STREAM_MAX_ERROR);
+}
+
+// streaming on means every frame goes out, off means only the ones main.c asks for (alarms)
+void frame_stream_set_enabled(bool enabled) {
+    streaming = enabled;
+}
+
+bool frame_stream_enabled(void) {
+    return streaming;
+}
+
+// 0 or less takes the cap off
+void frame_stream_set_rate(float max_fps) {
+    min_interval_us = (max_fps > 0) ? (int64_t)(1e6f / max_fps) : 0;
+}
+
+// Compresses the frame with the streaming encoder and queues the coded bytes as
+// FP_MSG_FRAME_FRAG fragments, usually 2-3 of them. All fragments are queued at once and the
+// delivery layer spaces them out, so a frame is on the air for a few ms, well inside the
+// 500 ms between sensor frames. Returns ESP_ERR_INVALID_STATE if the last frame went out
+// less than 1/max_fps ago.
+esp_err_t frame_stream_send(const float *image, float head_bearing) {
+    uint8_t buf[FP_MAX_PAYLOAD];
+    fp_frag_t *frag = (fp_frag_t *)buf;
+    int64_t now = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+
+    if (last_frame_us && now - last_frame_us < min_interval_us) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    last_frame_us = now;
+
+    // a fragment of an earlier frame never arrived, the reciever has nothing to apply deltas to
+    if (lost) {
+        lost = false;
+        tc_encoder_force_keyframe(&encoder);
+    }
+    tc_quantize(image, cells);
+    int coded_len = tc_encode(&encoder, cells, coded, sizeof(coded));
+    if (coded_len < 0) {
+        return ESP_FAIL;
+    }
+
+    int count = (coded_len + FP_FRAG_MAX_DATA - 1) / FP_FRAG_MAX_DATA;
+    for (int i = 0; i < count; i++) {
+        int first = i * FP_FRAG_MAX_DATA;
+        int n = coded_len - first;
+        if (n > FP_FRAG_MAX_DATA) n = FP_FRAG_MAX_DATA;
+        size_t len = sizeof(fp_frag_t) + n;
+
+        frag->frame_id = frame_id;
+        frag->index = i;
+        frag->count = count;
+        frag->bearing = fp_cdeg(head_bearing);
+        frag->crc = 0;
+        memcpy(frag->data, coded + first, n);
+        frag->crc = fp_crc16(frag, len);
+        esp_err_t e = wireless_send(FP_MSG_FRAME_FRAG, frag, len);
+        if (e != ESP_OK) err = e;
+    }
+    // if part of this frame never made it into the queue the reciever can't decode the
+    // deltas that follow, so start over from a keyframe
+    if (err != ESP_OK) {
+        tc_encoder_force_keyframe(&encoder);
+    }
+    frame_id++;
+    return err;
+}
+
+// The delivery layer gave up on (or evicted) one of our fragments. Only sets a flag, the
+// encoder belongs to the alert stage, which forces a keyframe with the next frame.
+void frame_stream_lost(void) {
+    lost = true;
+}
@@ -0,0 +1,27 @@
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Sends whole thermal frames to the reciever as FP_MSG_FRAME_FRAG fragments.
+// Frames are rate capped so streaming can't crowd out alerts; the default is one frame per
+// sensor refresh (2 Hz, see MLX90640_SetRefreshRate in main.c).
+#define FRAME_STREAM_MAX_FPS 2.0f
+// Frames are compressed with thermal_codec: every n-th one is a keyframe, and so is the next
+// one after a fragment got lost (dropped here or given up on by the delivery layer), so the
+// reciever is decoding again within one frame of a loss. Pixels may be off by up to
+// FRAME_STREAM_MAX_ERROR tenths of a degree (0 = lossless).
+#define FRAME_STREAM_KEYFRAME_INTERVAL 8
+#define FRAME_STREAM_MAX_ERROR 0
+
+// Function Declarations
+void frame_stream_init(void);
+void frame_stream_set_enabled(bool enabled);
+bool frame_stream_enabled(void);
+void frame_stream_set_rate(float max_fps);
+esp_err_t frame_stream_send(const float *image, float head_bearing);
+void frame_stream_lost(void);
+
+#endif // FRAME_STREAM_H
@@ -0,0 +1,134 @@
+#include <math.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "nvs.h"
+#include "stepper.h"
+#include "head.h"
+
+static head_config_t config = {
+    .steps_per_rev = HEAD_DEFAULT_STEPS_PER_REV,
+    .steps_per_position = HEAD_DEFAULT_STEPS_PER_POSITION,
+    .soft_limit = HEAD_DEFAULT_SOFT_LIMIT,
+    .home_offset = HEAD_DEFAULT_HOME_OFFSET,
+    .bearing_offset_deg = HEAD_DEFAULT_BEARING_CDEG / 100.0f,
+};
+
+static float wrap_bearing(float deg) {
+    deg = fmodf(deg, 360.0f);
+    if (deg < 0) deg += 360.0f;
+    return deg;
+}
+
+// anything set in NVS wins over the menuconfig defaults, missing keys are left alone
+static void load_overrides(void) {
+    nvs_handle_t nvs;
+    if (nvs_open("head", NVS_READONLY, &nvs) != ESP_OK) return;
+    int32_t v;
+    if (nvs_get_i32(nvs, "steps_rev", &v) == ESP_OK && v > 0) config.steps_per_rev = v;
+    if (nvs_get_i32(nvs, "step", &v) == ESP_OK && v > 0) config.steps_per_position = v;
+    if (nvs_get_i32(nvs, "limit", &v) == ESP_OK && v >= 0) config.soft_limit = v;
+    if (nvs_get_i32(nvs, "home_offset", &v) == ESP_OK) config.home_offset = v;
+    if (nvs_get_i32(nvs, "bearing", &v) == ESP_OK) config.bearing_offset_deg = v / 100.0f;
+    nvs_close(nvs);
+}
+
+// call after nvs_flash_init and stepper_init
+esp_err_t head_init(void) {
+    char message[120];
+    load_overrides();
+    #if HEAD_HOME_PIN >= 0
+    gpio_reset_pin(HEAD_HOME_PIN);
+    gpio_set_direction(HEAD_HOME_PIN, GPIO_MODE_INPUT);
+    gpio_set_pull_mode(HEAD_HOME_PIN, GPIO_PULLUP_ONLY);   // switch to ground
+    #endif
+    sprintf(message, "head: %ld steps/position, %ld steps/rev, limit +-%ld, position 0 at %.2f deg\n",
+            (long)config.steps_per_position, (long)config.steps_per_rev, (long)config.soft_limit,
+            config.bearing_offset_deg);
+    print_msg(message);
+    if (head_pos_steps(SCAN_MAX_POS) > config.soft_limit) {
+        sprintf(message, "head: the outer scan positions are past the soft limit, they'll stop at it\n");
+        print_msg(message);
+    }
+    return ESP_OK;
+}
+
+// Finds the home switch by creeping ccw a few microsteps at a time, then sets that spot to
+// -home_offset and drives to position 0. Without a switch the head stays where it is and
+// that is position 0. Blocks until done; ESP_ERR_NOT_FOUND if the switch never closed.
+esp_err_t head_home(void) {
+    #if HEAD_HOME_PIN >= 0
+    int32_t crept = 0;
+    while (gpio_get_level(HEAD_HOME_PIN) != 0) {
+        if (crept >= HEAD_HOME_MAX_STEPS) return ESP_ERR_NOT_FOUND;
+        stepper_move(-HEAD_HOME_CHUNK_STEPS, NULL, NULL);
+        stepper_wait(pdMS_TO_TICKS(100));
+        crept += HEAD_HOME_CHUNK_STEPS;
+    }
+    stepper_set_position(-config.home_offset);
+    esp_err_t err = head_move_to_steps(0);
+    stepper_wait(portMAX_DELAY);
+    return err;
+    #else
+    stepper_set_position(0);
+    return ESP_OK;
+    #endif
+}
+
+const head_config_t *head_get_config(void) {
+    return &config;
+}
+
+int32_t head_pos_steps(int pos) {
+    return pos * config.steps_per_position;
+}
+
+// Starts a move to an absolute microstep position, clamped to the soft limits. Returns
+// straight away like stepper_move.
+esp_err_t head_move_to_steps(int32_t target) {
+    if (target > config.soft_limit) target = config.soft_limit;
+    if (target < -config.soft_limit) target = -config.soft_limit;
+    return stepper_move(target - stepper_position(), NULL, NULL);
+}
+
+esp_err_t head_move_to_pos(int pos) {
+    return head_move_to_steps(head_pos_steps(pos));
+}
+
+// world bearing the middle of the sensor looks at with the motor at steps
+float head_steps_bearing(int32_t steps) {
+    return wrap_bearing(config.bearing_offset_deg + steps * 360.0f / config.steps_per_rev);
+}
+
+// same for a scan position, as far as the soft limits let it get there
+float head_pos_bearing(int pos) {
+    int32_t steps = head_pos_steps(pos);
+    if (steps > config.soft_limit) steps = config.soft_limit;
+    if (steps < -config.soft_limit) steps = -config.soft_limit;
+    return head_steps_bearing(steps);
+}
+
+// bearing of a (fractional) pixel column, whole numbers are pixel centres
+float head_pixel_bearing(float head_bearing, float col) {
+    #ifdef SENSOR_MIRRORED
+    col = NUM_COLS - 1 - col;
+    #endif
+    float deg_per_px = SENSOR_FOV_H_DEG / NUM_COLS;
+    return wrap_bearing(head_bearing + (col + 0.5f - NUM_COLS / 2.0f) * deg_per_px);
+}
+
+// scan position pointing closest to bearing; *in_view says whether it's inside that
+// position's field of view at all
+int head_bearing_to_pos(float bearing, bool *in_view) {
+    int best = 0;
+    float best_d = 360.0f;
+    for (int pos = SCAN_MIN_POS; pos <= SCAN_MAX_POS; pos++) {
+        float d = fabsf(fmodf(bearing - head_pos_bearing(pos) + 540.0f, 360.0f) - 180.0f);
+        if (d < best_d) {
+            best_d = d;
+            best = pos;
+        }
+    }
+    if (in_view) *in_view = best_d <= SENSOR_FOV_H_DEG / 2;
+    return best;
+}
@@ -0,0 +1,55 @@
+#ifndef HEAD_H
+#define HEAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "main.h"
+
+// Motion model for the rotating head. The stepper keeps the absolute position in microsteps
+// (0 = home, cw positive); this turns it into scan positions and world bearings and keeps
+// every move inside the soft limits so the cable can't wind up.
+//
+// Defaults come from menuconfig ("Fire detector head", Kconfig.projbuild). A deployment can
+// override the runtime ones in NVS, namespace "head", without rebuilding -- see the README.
+// The number of scan positions sizes several tables, so that one is menuconfig only.
+#ifdef CONFIG_HEAD_MOTOR_STEPS_PER_REV
+#define HEAD_DEFAULT_STEPS_PER_REV CONFIG_HEAD_MOTOR_STEPS_PER_REV
+#define HEAD_DEFAULT_STEPS_PER_POSITION CONFIG_HEAD_STEPS_PER_POSITION
+#define HEAD_DEFAULT_SOFT_LIMIT CONFIG_HEAD_SOFT_LIMIT_STEPS
+#define HEAD_DEFAULT_BEARING_CDEG CONFIG_HEAD_BEARING_OFFSET_CDEG
+#define HEAD_HOME_PIN CONFIG_HEAD_HOME_PIN
+#define HEAD_DEFAULT_HOME_OFFSET CONFIG_HEAD_HOME_OFFSET_STEPS
+#define HEAD_HOME_MAX_STEPS CONFIG_HEAD_HOME_MAX_STEPS
+#else
+#define HEAD_DEFAULT_STEPS_PER_REV 1600     // 200 full steps * driver microstep setting
+#define HEAD_DEFAULT_STEPS_PER_POSITION 70
+#define HEAD_DEFAULT_SOFT_LIMIT 280         // either side of home
+#define HEAD_DEFAULT_BEARING_CDEG 0
+#define HEAD_HOME_PIN -1                    // no home switch: position 0 is wherever it powered up
+#define HEAD_DEFAULT_HOME_OFFSET 0
+#define HEAD_HOME_MAX_STEPS 1600
+#endif
+#define HEAD_HOME_CHUNK_STEPS 2             // homing creeps this far at a time, checking the switch in between
+
+typedef struct {
+    int32_t steps_per_rev;          // microsteps per turn of the head
+    int32_t steps_per_position;     // microsteps between neighbouring scan positions
+    int32_t soft_limit;             // no move goes further than this from home, either way
+    int32_t home_offset;            // microsteps from the home switch to position 0, cw positive
+    float bearing_offset_deg;       // world bearing the middle of the sensor looks at from position 0
+} head_config_t;
+
+// Function Declarations
+esp_err_t head_init(void);
+esp_err_t head_home(void);
+const head_config_t *head_get_config(void);
+int32_t head_pos_steps(int pos);
+esp_err_t head_move_to_steps(int32_t target);
+esp_err_t head_move_to_pos(int pos);
+float head_steps_bearing(int32_t steps);
+float head_pos_bearing(int pos);
+float head_pixel_bearing(float head_bearing, float col);
+int head_bearing_to_pos(float bearing, bool *in_view);
+
+#endif // HEAD_H
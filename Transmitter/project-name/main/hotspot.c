@@ -0,0 +1,78 @@
+#include <string.h>
+#include "main.h"
+#include "MLX90640_API.h"
+#include "hotspot.h"
+
+// scratch space for the flood fill, kept static so the main task's stack stays small
+static uint16_t fill_stack[NUM_ROWS*NUM_COLS];
+static uint8_t visited[NUM_ROWS*NUM_COLS];
+
+float hotspot_frame_mean(const float *image) {
+    float sum = 0;
+    for (int i = 0; i < NUM_ROWS*NUM_COLS; i++) {
+        sum += image[i];
+    }
+    return sum / (NUM_ROWS*NUM_COLS);
+}
+
+static int pixel_in_mask(int idx, uint64_t tileMask) {
+    return (tileMask >> MLX90640_TILE_OF(idx)) & 1;
+}
+
+// Groups pixels >= threshold into 4-connected blobs, looking only at pixels inside tileMask
+// (pass MLX90640_ALL_TILES to search the whole frame). Blobs are returned hottest first;
+// if there are more than max_blobs the coolest ones are dropped. Returns the blob count.
+int hotspot_find(const float *image, uint64_t tileMask, float threshold, hotspot_blob_t *blobs, int max_blobs) {
+    int count = 0;
+    memset(visited, 0, sizeof(visited));
+
+    for (int seed = 0; seed < NUM_ROWS*NUM_COLS; seed++) {
+        if (visited[seed] || image[seed] < threshold || !pixel_in_mask(seed, tileMask)) continue;
+
+        hotspot_blob_t b = { .peak = image[seed], .peak_idx = seed };
+        float sum = 0, wsum = 0, wx = 0, wy = 0;
+        int sp = 0;
+        fill_stack[sp++] = seed;
+        visited[seed] = 1;
+
+        while (sp > 0) {
+            int i = fill_stack[--sp];
+            int x = i % NUM_COLS;
+            int y = i / NUM_COLS;
+            float t = image[i];
+            float w = t - threshold + 1.0f;
+
+            b.size++;
+            sum += t;
+            wsum += w;
+            wx += w * x;
+            wy += w * y;
+            if (t > b.peak) {
+                b.peak = t;
+                b.peak_idx = i;
+            }
+
+            int nb[4] = { x > 0 ? i - 1 : -1, x < NUM_COLS - 1 ? i + 1 : -1,
+                          y > 0 ? i - NUM_COLS : -1, y < NUM_ROWS - 1 ? i + NUM_COLS : -1 };
+            for (int k = 0; k < 4; k++) {
+                int n = nb[k];
+                if (n < 0 || visited[n] || image[n] < threshold || !pixel_in_mask(n, tileMask)) continue;
+                visited[n] = 1;
+                fill_stack[sp++] = n;
+            }
+        }
+        b.mean = sum / b.size;
+        b.cx = wx / wsum;
+        b.cy = wy / wsum;
+
+        // insert sorted by peak, hottest first
+        int pos = count;
+        while (pos > 0 && blobs[pos-1].peak < b.peak) pos--;
+        if (pos >= max_blobs) continue;
+        int last = (count < max_blobs) ? count : max_blobs - 1;
+        for (int k = last; k > pos; k--) blobs[k] = blobs[k-1];
+        blobs[pos] = b;
+        if (count < max_blobs) count++;
+    }
+    return count;
+}
@@ -0,0 +1,24 @@
+#ifndef HOTSPOT_H
+#define HOTSPOT_H
+
+#include <stdint.h>
+#include "main.h"
+
+#define HOTSPOT_MAX_BLOBS 8
+#define HOTSPOT_DELTA_C 6.0f        // a pixel has to be this much warmer than the frame mean to count
+#define FIRE_THRESHOLD_C 130.0f     // flame from a lighter measured ~147 C, see main loop
+
+// one connected group of warm pixels
+typedef struct {
+    float peak;             // hottest pixel (C)
+    float mean;             // average over the blob (C)
+    uint16_t peak_idx;      // pixel index of the peak
+    uint16_t size;          // pixels in the blob
+    float cx, cy;           // temperature weighted centroid in pixel coordinates
+} hotspot_blob_t;
+
+// Function Declarations
+float hotspot_frame_mean(const float *image);
+int hotspot_find(const float *image, uint64_t tileMask, float threshold, hotspot_blob_t *blobs, int max_blobs);
+
+#endif // HOTSPOT_H
@@ -19,6 +19,28 @@
 // necessary files for writing code to interact with MLX90640 camera
 #include "MLX90640_I2C_Driver.h" 
 #include "MLX90640_API.h"
+#include "panorama.h"
+#include "change_detect.h"
+#include "MLX90640_Pyramid.h"
+#include "hotspot.h"
+#include "thermal_filter.h"
+#include "tracker.h"
+#include "esp_timer.h"
+#include "benchmarks.h"
+#include "delivery.h"
+#include "frame_stream.h"
+#include "tx_queue.h"
+#include "relay.h"
+#include "stepper.h"
+#include "head.h"
+#include "scan.h"
+#include "scheduler.h"
+#include "pipeline.h"
+#include "perf.h"
+#include "dlog.h"
+#include "boot.h"
+#include "power.h"
+#include "blackbox.h"
 
 int curr_pos = 0;
 int prev_pos = 0;
@@ -30,48 +52,125 @@ uint8_t receiver_mac[] = {0x81, 0xD1, 0xF9, 0xDD, 0x54, 0x3C}; // REPLACE WITH Y
 // float frame[NUM_ROWS*NUM_COLS]; // buffer for full frame of temperatures
 // space for eeprom data to be stored
 static uint16_t eeMLX90640[832]; //(NUM_ROWS+2)*NUM_COLS -- as described in driver pdf
-// pointer to camera frame data already acquired
-static uint16_t mlx90640Frame[834];
 // pointer to MCU memory where already extracted params for device are stored (params decided by manufacturer)
 paramsMLX90640 mlx90640;
-static float mlx90640Image[NUM_ROWS*NUM_COLS]; //768
-static float mlx90640Image_compare[NUM_ROWS*NUM_COLS]; //768
+static void denoise(float *image);
+static void send_alert(uint8_t level, float peak, float bearing, int blob_px, const track_t *track);
+static void command_task(void *arg);
+
+// One frame on its way down the pipeline, with everything the later stages need to know
+// about it. The stage holding the slot owns it, slots go round through the queues below.
+typedef struct {
+    scan_tag_t tag;
+    uint16_t raw[834];                          // (NUM_ROWS+2)*NUM_COLS + 2 words from the sensor
+    float image[NUM_ROWS*NUM_COLS];             // calibrated and denoised, C (t_max is from before denoising)
+    int64_t started_us;                         // calibrate started on it
+    float ta, t_max, t_min;
+    int t_max_col;
+    uint64_t calc_tiles, hot_tiles;
+    float head_bearing, t_max_bearing;
+    hotspot_blob_t hotspots[HOTSPOT_MAX_BLOBS];
+    int num_hotspots;
+    track_t hottest;                            // a copy, the tracker has moved on by the time alert looks
+    bool has_track;
+    int confirmed_tracks;
+    uint8_t state;
+} frame_slot_t;
+
+// requests for the actuate stage, which owns the scheduler and the motor
+typedef enum {
+    ACT_FRAME,          // a frame was calibrated: let the scheduler see it and move on (or not)
+    ACT_FLAG,           // something worth coming back to at bearing
+    ACT_REACQUIRE,      // a growing track went out of view at bearing, go back to it next
+} actuate_kind_t;
+
+typedef struct {
+    uint8_t kind;       // actuate_kind_t
+    int pos;
+    float t_max, ta, bearing;
+    int changed_tiles;
+} actuate_req_t;
+
+// acquire -> calibrate -> actuate (the next move, then lets acquire go again)
+//                      -> detect -> alert -> back to free
+// name, task, stack (bytes), priority, core, time budget per frame (us). The budget is the
+// deadline for the time between pipeline_begin and pipeline_end (see perf.h): for acquire that's mostly waiting for the
+// head and the sensor, for the others it's their processing. The radio runs on core 0, so
+// the number crunching goes on core 1. Stages that send get 256 bytes extra for the
+// tx_queue item wireless_send copies through their stack.
+#define PIPELINE_SLOTS 3
+#define FIRE_PIPELINE(STAGE) \
+    STAGE(acquire,   acquire_stage,   3072, 6, 1, 1200000) \
+    STAGE(calibrate, calibrate_stage, 4096, 5, 1, 60000) \
+    STAGE(actuate,   actuate_stage,   3072, 7, 1, 2000) \
+    STAGE(detect,    detect_stage,    6400, 4, 1, 40000) \
+    STAGE(alert,     alert_stage,     4352, 3, 0, 20000)
+
+// commands from the reciever (panorama, perf stats, black box) are run by a task of their own
+// so a slow dump never holds up the pipeline
+#define COMMAND_TASK_STACK 4096
+#define COMMAND_TASK_PRIORITY 1         // below every pipeline stage
+#define COMMAND_TASK_CORE 0
+
+FIRE_PIPELINE(PIPELINE_DECLARE)
+enum { FIRE_PIPELINE(PIPELINE_ID) NUM_STAGES };
+static const pipeline_stage_t stages[] = { FIRE_PIPELINE(PIPELINE_ENTRY) };
+
+PIPELINE_QUEUE(free_q, frame_slot_t *, PIPELINE_SLOTS)
+PIPELINE_QUEUE(calibrate_q, frame_slot_t *, PIPELINE_SLOTS)
+PIPELINE_QUEUE(detect_q, frame_slot_t *, PIPELINE_SLOTS)
+PIPELINE_QUEUE(alert_q, frame_slot_t *, PIPELINE_SLOTS)
+PIPELINE_QUEUE(actuate_q, actuate_req_t, 4)
+
+static frame_slot_t slots[PIPELINE_SLOTS];
+static pyramidMLX90640 mlx90640Pyramid;         // calibrate only
+static float hotspot_bearings[HOTSPOT_MAX_BLOBS];   // detect only
+static uint32_t frames_processed = 0;           // alert only
+static uint32_t capture_failures = 0;           // acquire only
+static int64_t last_heartbeat_us = INT64_MIN / 2;   // first one goes out with the first frame
+static uint8_t last_sent_state = 0xFF;
+static StackType_t command_task_stack[COMMAND_TASK_STACK];
+static StaticTask_t command_task_tcb;
 
 // uncomment *one* of the below
 //#define PRINT_TEMPERATURES
 #define PRINT_ASCIIART
 
-void app_main() {
-    char message[100];  // we'll use for all our printing 
+// uncomment *one* of the below to denoise every frame before the blob search and tracking
+// (the median keeps edges sharp, but also removes a lone hot pixel -- which is why t_max and
+// the fire threshold are taken before denoising)
+#define DENOISE_MEDIAN
+//#define DENOISE_GAUSSIAN
 
-    // initializing connections
-    uart_init(); 
-    MLX90640_I2CInit(); 
-    wifi_init();
-    nvs_flash_init();
-    esp_netif_init();
-    esp_event_loop_create_default();
-    esp_wifi_init(&(wifi_init_config_t)WIFI_INIT_CONFIG_DEFAULT());
-    esp_wifi_set_mode(WIFI_MODE_STA);
-    esp_wifi_start();
+// uncomment to time the processing stages on live frames once at boot
+//#define RUN_BENCHMARKS
 
-    esp_now_init();
+// after a failed sensor read, wait this long before trying again
+#define CAPTURE_RETRY_MS 100
 
-    esp_now_register_send_cb(on_data_sent);
-    esp_now_peer_info_t peer = {};
-    memcpy(peer.peer_addr, receiver_mac, 6);
-    peer.channel = 0;
-    peer.encrypt = false;
+// send a telemetry message every this many frames
+#define TELEMETRY_EVERY_N_FRAMES 10
 
-    if (esp_now_add_peer(&peer) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to add peer\n");
-        return;
-    }
-    sprintf(message, "Wireless Connection Enabled\n");
-    esp_now_send(receiver_mac,(uint8_t*)message, sizeof(message));
+// while the state is OK only a heartbeat goes out this often (instead of a status every
+// frame); the reciever calls us offline after a few missed ones. Max 255.
+#define HEARTBEAT_PERIOD_S 5
 
-    vTaskDelay(pdMS_TO_TICKS(3000));
+// uncomment to also forward other detectors' messages to the reciever (multi-hop, see relay.h)
+// far detectors then need this board's MAC as their receiver_mac
+//#define RELAY_MODE
 
+// Bring-up, see boot.h. The radio and the head come up in lanes of their own while this task
+// reads the sensor's EEPROM and sets it up; nothing waits on a fixed delay any more.
+static esp_err_t boot_nvs(void) {
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        nvs_flash_erase();
+        err = nvs_flash_init();
+    }
+    return err;
+}
+
+static esp_err_t boot_leds(void) {
     // set up alarm LED pin
     gpio_reset_pin(RED_LED_PIN);
     gpio_set_direction(RED_LED_PIN, GPIO_MODE_OUTPUT);
@@ -86,18 +185,83 @@ void app_main() {
     gpio_reset_pin(YELLOW_LED_PIN);
     gpio_set_direction(YELLOW_LED_PIN, GPIO_MODE_OUTPUT);
     gpio_set_level(YELLOW_LED_PIN,1);
-    vTaskDelay(pdMS_TO_TICKS(5000));
-
-    // set up motor pins
-    gpio_reset_pin(STEP_PIN);
-    gpio_set_direction(STEP_PIN, GPIO_MODE_OUTPUT);
-    gpio_set_level(STEP_PIN,0);
-    gpio_reset_pin(DIR_PIN);
-    gpio_set_direction(DIR_PIN, GPIO_MODE_OUTPUT);
-    gpio_set_level(DIR_PIN,0);
-
-    // set up one-time settings
-    MLX90640_DumpEE (DEVICE_ADDR, eeMLX90640);  // need to dump eeprom to get access the paramters
+    return ESP_OK;
+}
+
+// the send and command queues exist before any lane starts, so wireless_send works (and
+// just fails to deliver) and the command task has something to wait on even if the radio
+// never comes up
+static esp_err_t boot_tx_queues(void) {
+    wireless_init();
+    delivery_init();
+    tx_queue_init();
+    return ESP_OK;
+}
+
+static esp_err_t boot_espnow(void) {
+    esp_err_t err = esp_now_init();
+    if (err != ESP_OK) return err;
+    esp_now_register_send_cb(on_data_sent);
+    esp_now_register_recv_cb(on_data_recv);
+    esp_now_peer_info_t peer = {};
+    memcpy(peer.peer_addr, receiver_mac, 6);
+    peer.channel = 0;
+    peer.encrypt = false;
+
+    err = esp_now_add_peer(&peer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add peer\n");
+        return err;
+    }
+    wireless_set_peer(receiver_mac);
+    #ifdef RELAY_MODE
+    // commands from the reciever are broadcast, and we pass them on the same way
+    esp_now_peer_info_t bcast = {};
+    memset(bcast.peer_addr, 0xFF, 6);
+    esp_now_add_peer(&bcast);
+    relay_init();
+    power_radio_always_on();    // a relay has to hear the others, sentinel or not
+    #endif
+    return ESP_OK;
+}
+
+static void radio_lane(void) {
+    if (boot_step("wifi", wifi_init) != ESP_OK) return;
+    if (boot_step("esp-now", boot_espnow) == ESP_OK) wireless_send_text("Wireless Connection Enabled\n");
+    boot_step("power", power_init);
+}
+
+static esp_err_t boot_home(void) {
+    esp_err_t err = head_home();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Home switch not found, scanning from where the head is\n");
+        stepper_set_position(0);
+    }
+    return err;
+}
+
+// set up the motor (step pulses come from the RMT, see stepper.h) and find home
+static void head_lane(void) {
+    if (boot_step("stepper", stepper_init) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up the stepper\n");
+    }
+    boot_step("head", head_init);
+    boot_step("home", boot_home);
+}
+
+static esp_err_t boot_sensor_i2c(void) {
+    MLX90640_I2CInit();     // straight at 400 kHz, the EEPROM is fine with that
+    return ESP_OK;
+}
+
+static esp_err_t boot_eeprom(void) {
+    // need to dump eeprom to get access the paramters
+    return MLX90640_DumpEE(DEVICE_ADDR, eeMLX90640) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+// set up one-time settings
+static esp_err_t boot_sensor_setup(void) {
+    char message[100];
     MLX90640_SetResolution(DEVICE_ADDR, 0x03);  // 16bit resolution
     int curResolution;
     curResolution = MLX90640_GetCurResolution(DEVICE_ADDR);
@@ -114,12 +278,52 @@ void app_main() {
     mode = MLX90640_GetCurMode(0x33);
     sprintf(message,"current mode(%d)=%s\n",mode,(mode?"chess":"interleaved"));
     print_msg(message);
+    return ESP_OK;
+}
 
-    MLX90640_ExtractParameters(eeMLX90640,&mlx90640);   // extracting them from the previous eeprom dump
+static esp_err_t boot_parameters(void) {
+    char message[100];
+    // extracting them from the previous eeprom dump
+    if (MLX90640_ExtractParameters(eeMLX90640,&mlx90640) != 0) return ESP_FAIL;
     sprintf(message, "Extracting parameters done!\nVdd=%d\n", mlx90640.vdd25);
     print_msg(message);
-    MLX90640_I2CFreqSet(400);
+    return ESP_OK;
+}
+
+static esp_err_t boot_detection(void) {
+    panorama_init();
+    change_detect_init();
+    tracker_init();
+    frame_stream_init();
+    return ESP_OK;
+}
 
+// needs the head homed: the scan starts counting moves from here
+static esp_err_t boot_scan(void) {
+    sched_init();
+    scan_init();
+    return ESP_OK;
+}
+
+void app_main() {
+    // initializing connections
+    perf_init();
+    uart_init(); 
+    dlog_init();
+    boot_step("leds", boot_leds);
+    boot_step("nvs", boot_nvs);         // wifi and the head settings both read it
+    boot_step("tx queues", boot_tx_queues);
+    boot_spawn("radio", radio_lane);
+    boot_spawn("head", head_lane);
+
+    boot_step("i2c", boot_sensor_i2c);
+    boot_step("eeprom", boot_eeprom);
+    boot_step("sensor setup", boot_sensor_setup);
+    boot_step("parameters", boot_parameters);
+    #ifdef RUN_BENCHMARKS
+    char message[100];
+    uint16_t *mlx90640Frame = slots[0].raw;     // the pipeline isn't running yet, borrow a slot
+    float *mlx90640Image = slots[0].image;
     MLX90640_GetFrameData(DEVICE_ADDR, mlx90640Frame);
     int subPage;
     subPage = MLX90640_GetSubPageNumber(mlx90640Frame);     // this is for testing moreso
@@ -129,33 +333,103 @@ void app_main() {
     print_msg(message);
 
     MLX90640_GetImage(mlx90640Frame, &mlx90640, mlx90640Image);
-    sprintf(message, "Device Initialized\n");
-    esp_now_send(receiver_mac,(uint8_t*)message, sizeof(message));
+    benchmark_pyramid(&mlx90640, mlx90640Frame, 20);
+    benchmark_filters(mlx90640Image, 100);
+    #endif
+    boot_step("detection", boot_detection);
+    boot_step("blackbox", blackbox_init);
+    boot_join();
+    boot_step("scan", boot_scan);
+    wireless_send_text("Device Initialized\n");
+    gpio_set_level(GREEN_LED_PIN,1);
+    gpio_set_level(YELLOW_LED_PIN,0);
+
+    // from here on everything runs in the pipeline's tasks, no heap use past this point
+    PIPELINE_QUEUE_INIT(free_q);
+    PIPELINE_QUEUE_INIT(calibrate_q);
+    PIPELINE_QUEUE_INIT(detect_q);
+    PIPELINE_QUEUE_INIT(alert_q);
+    PIPELINE_QUEUE_INIT(actuate_q);
+    for (int i = 0; i < PIPELINE_SLOTS; i++) {
+        frame_slot_t *slot = &slots[i];
+        xQueueSend(free_q, &slot, 0);
+    }
+    xTaskCreateStaticPinnedToCore(command_task, "command", COMMAND_TASK_STACK, NULL, COMMAND_TASK_PRIORITY,
+                                  command_task_stack, &command_task_tcb, COMMAND_TASK_CORE);
+    pipeline_start(stages, NUM_STAGES);
+}
+
+// Takes a frame at wherever actuate last sent the head. Waits for actuate's go-ahead first,
+// otherwise we'd take a second frame from the same spot before the move has even started.
+static void acquire_stage(void *arg) {
+    int stage = (intptr_t)arg;
+    bool first = true;
+    while (1) {
+        if (!first) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        first = false;
+        power_wait_frame();     // sleeps out the gap between frames in sentinel
+        frame_slot_t *f;
+        xQueueReceive(free_q, &f, portMAX_DELAY);
+        perf_mark_t t0 = pipeline_begin();
+        // the last move may still be running, this waits for it and for a subpage taken
+        // after the head stopped
+        int subpage = scan_capture(f->raw, &f->tag);
+        pipeline_end(stage, t0);
+        if (subpage < 0) {
+            // an I2C error or the sensor never got ready: raw (and maybe tag) is stale or
+            // half written, so the slot goes back and we try again from the same spot
+            capture_failures++;
+            DLOG(DLOG_WARN, "capture failed (%d), %lu so far\n", subpage, (unsigned long)capture_failures);
+            xQueueSend(free_q, &f, portMAX_DELAY);
+            vTaskDelay(pdMS_TO_TICKS(CAPTURE_RETRY_MS));
+            first = true;       // no move coming to wait for
+            continue;
+        }
+        xQueueSend(calibrate_q, &f, portMAX_DELAY);
+    }
+}
+
+// Raw words to temperatures, and the max/min that decide whether the head may move on.
+static void calibrate_stage(void *arg) {
+    int stage = (intptr_t)arg;
     while (1) {
-        // printf("In the main loop\n");
-        //print_msg("hi\n");
-        //uart_write_bytes(UART_NUM, message, strlen(message)); // Send message over UART
-        // wirelessmessagetest();
-        // read_mac_address();
-        gpio_set_level(GREEN_LED_PIN,1);
-        gpio_set_level(YELLOW_LED_PIN,0);
-
-        MLX90640_GetFrameData(DEVICE_ADDR, mlx90640Frame);
-        float ta = MLX90640_GetTa(mlx90640Frame, &mlx90640);
-        sprintf(message, "Ambinet temperature=%f\n", ta);     // in testing = ~29 C
-        print_msg(message);
+        frame_slot_t *f;
+        xQueueReceive(calibrate_q, &f, portMAX_DELAY);
+        perf_mark_t t0 = pipeline_begin();
+        f->started_us = esp_timer_get_time();
+        float ta = MLX90640_GetTa(f->raw, &mlx90640);
+        f->ta = ta;
+        DLOG(DLOG_INFO, "Ambinet temperature=%f\n", ta);     // in testing = ~29 C
 
         // gets the ACTUAL (calculated) temperature of object in C
         // emissivity (how reflective obj is) = 0.95
         // reflected temperature (tr) -- in driver pdf says that ta-8 is pretty standard
-        MLX90640_CalculateTo(mlx90640Frame, &mlx90640, 0.95, ta-8, mlx90640Image);  
+        // only tiles that changed since we last looked from this position get recalculated, the
+        // rest are reused from the last visit. Whether a tile looks warm in the coarse raw pass
+        // (hot_tiles) only narrows the blob search -- a cold tile that changed may be a fire
+        // starting, and a hot one that changed may have cooled down
+        int pos_slot = f->tag.pos - SCAN_MIN_POS;
+        MLX90640_BuildPyramid(f->raw, &mlx90640, &mlx90640Pyramid);
+        uint64_t changed_tiles = change_detect_update(pos_slot, &mlx90640Pyramid, ta);
+        f->hot_tiles = MLX90640_DilateTiles(MLX90640_PyramidHotTiles(&mlx90640Pyramid, PYRAMID_HOT_DELTA));
+        f->calc_tiles = changed_tiles;
+        change_detect_restore(pos_slot, f->image);
+        perf_mark_t p = perf_now();
+        MLX90640_CalculateToTiles(f->raw, &mlx90640, 0.95, ta-8, f->image, f->calc_tiles);
+        perf_probe(PERF_calculate, p);
+        change_detect_store(pos_slot, f->image, f->calc_tiles);
         float t_max=-1000; 
         float t_min=1000;
+        int t_max_col=0;
+        p = perf_now();
         for (uint8_t h=0; h<24; h++) {
             for (uint8_t w=0; w<32; w++) {
-                float t = mlx90640Image[h*32 + w];
+                float t = f->image[h*32 + w];
                 // storing min/max temps -- for sanity check but also could use to set alarm trigger
-                if(t>t_max) t_max=t;
+                if(t>t_max) {
+                    t_max=t;
+                    t_max_col=w;
+                }
                 if(t<t_min) t_min=t;
 
                 #ifdef PRINT_TEMPERATURES
@@ -174,59 +448,288 @@ void app_main() {
                     else if (t < 33) c = '%';
                     else if (t < 35) c = '#';
                     else if (t < 37) c = 'X';
-                    // sprintf(message, "%c", c);     // for printing ascii map
-                    sprintf(message, "%.3f,",t);      // for printing values -- can use in excel
-                    print_msg(message);
+                    // DLOG(DLOG_DEBUG, "%c", c);     // for printing ascii map
+                    DLOG(DLOG_DEBUG, "%.3f,", t);     // for printing values -- can use in excel
                 */
                 #endif
             }
-            sprintf(message, "\n");
-            print_msg(message);
+            DLOG(DLOG_DEBUG, "\n");
         }
-        sprintf(message, "t_max=%f, t_min=%f\n", t_max, t_min);
-        print_msg(message);
-        
-        while (t_max >= 130) {
+        perf_probe(PERF_reduce, p);
+        // t_max and the alarms come from the unfiltered frame: a small or far away fire is only
+        // a pixel or two here, and the median would take it out. Blobs and tracks get the
+        // denoised image. The cache keeps the unfiltered temperatures, otherwise unchanged
+        // tiles would get filtered again on every visit.
+        denoise(f->image);
+        f->t_max = t_max;
+        f->t_min = t_min;
+        f->t_max_col = t_max_col;
+        pipeline_end(stage, t0);
+
+        // actuate decides about the next move straight away, the rest of this frame is
+        // processed and sent while the head travels
+        actuate_req_t req = {
+            .kind = ACT_FRAME,
+            .pos = f->tag.pos,
+            .t_max = t_max,
+            .ta = ta,
+            .changed_tiles = changed_tiles == MLX90640_ALL_TILES ? 0 : __builtin_popcountll(changed_tiles),
+        };
+        xQueueSend(actuate_q, &req, portMAX_DELAY);
+        xQueueSend(detect_q, &f, portMAX_DELAY);
+    }
+}
+
+// Moves the head and feeds the scheduler. No other stage changes either; detect reads the
+// motor position and alert sends the scheduler's stats.
+static void actuate_stage(void *arg) {
+    int stage = (intptr_t)arg;
+    while (1) {
+        actuate_req_t req;
+        xQueueReceive(actuate_q, &req, portMAX_DELAY);
+        perf_mark_t t0 = pipeline_begin();
+        if (req.kind == ACT_FLAG) {
+            sched_flag_bearing(req.bearing, 1.0f);
+            pipeline_end(stage, t0);
+            continue;
+        }
+        if (req.kind == ACT_REACQUIRE) {
+            sched_flag_bearing(req.bearing, 1.0f);
+            sched_focus_bearing(req.bearing);
+            pipeline_end(stage, t0);
+            continue;
+        }
+        sched_observe(req.pos, req.t_max, req.ta, req.changed_tiles);
+        // no fire in view, so the head can go on to the next position. While there is one
+        // the head stays put and every frame from here raises the alarm again
+        if (req.t_max < FIRE_THRESHOLD_C) {
+            perf_mark_t p = perf_now();
+            scan_start_move();
+            perf_probe(PERF_motor, p);
+        }
+        pipeline_end(stage, t0);
+        xTaskNotifyGive(pipeline_task(STAGE_acquire));
+    }
+}
+
+// Where things are and what they're doing: panorama, blobs, tracks, and the warning state.
+static void detect_stage(void *arg) {
+    int stage = (intptr_t)arg;
+    while (1) {
+        frame_slot_t *f;
+        xQueueReceive(detect_q, &f, portMAX_DELAY);
+        perf_mark_t t0 = pipeline_begin();
+        // fold this view into the 360 map and report the hottest point as an absolute bearing
+        // from where the motor actually was, not where the position should be
+        f->head_bearing = head_steps_bearing(f->tag.motor_steps);
+        f->t_max_bearing = head_pixel_bearing(f->head_bearing, f->t_max_col);
+        panorama_add_frame(f->image, f->head_bearing);
+        DLOG(DLOG_INFO, "t_max=%f at %.1f deg, t_min=%f\n", f->t_max, f->t_max_bearing, f->t_min);
+        DLOG(DLOG_INFO, "tiles recalculated: %d/%d\n", __builtin_popcountll(f->calc_tiles), MLX90640_NUM_TILES);
+
+        // blob analysis, again only in the tiles that passed the coarse test
+        float hotspot_threshold = hotspot_frame_mean(f->image) + HOTSPOT_DELTA_C;
+        f->num_hotspots = hotspot_find(f->image, f->hot_tiles, hotspot_threshold, f->hotspots, HOTSPOT_MAX_BLOBS);
+        for (int i = 0; i < f->num_hotspots; i++) {
+            hotspot_bearings[i] = head_pixel_bearing(f->head_bearing, f->hotspots[i].cx);
+        }
+
+        // follow the blobs from frame to frame (and across scan positions) so we know whether
+        // something is moving or growing, not just that it's warm
+        tracker_update(f->hotspots, hotspot_bearings, f->num_hotspots, f->head_bearing, esp_timer_get_time());
+        const track_t *tracks;
+        int num_tracks = tracker_get(&tracks);
+        f->confirmed_tracks = 0;
+        for (int i = 0; i < num_tracks; i++) {
+            if (!tracks[i].active || tracks[i].hits < TRACK_CONFIRM_HITS) continue;
+            f->confirmed_tracks++;
+            DLOG(DLOG_INFO, "track %d: %s at %.1f deg (%+.1f deg/s) peak=%.1f (%+.2f C/s) size=%.0f\n",
+                 tracks[i].id, tracker_class_name(tracks[i].cls), tracks[i].x[0], tracks[i].x[1],
+                 tracks[i].x[2], tracks[i].x[3], tracks[i].x[4]);
+        }
+        // a hotspot that stays put while it heats up or spreads is worth a warning before it
+        // reaches the fire threshold -- a person walking past never gets classified as growing
+        const track_t *hottest_track = tracker_hottest();
+        f->has_track = hottest_track != NULL;
+        if (hottest_track) f->hottest = *hottest_track;
+        f->state = FP_STATE_OK;
+        if (f->t_max >= FIRE_THRESHOLD_C) {
+            f->state = FP_STATE_FIRE;
+        } else if (hottest_track && hottest_track->cls == TRACK_GROWING) {
+            f->state = FP_STATE_WARNING;
+            // keep coming back to it, it may be off to the side of where we are now
+            actuate_req_t req = {
+                .kind = ACT_FLAG,
+                .bearing = hottest_track->x[0],
+            };
+            xQueueSend(actuate_q, &req, portMAX_DELAY);
+        }
+        // a growing hotspot the head has moved away from (or that moved out of the frame):
+        // point the head back at where the tracker expects it to be
+        const track_t *lost_track = tracker_lost();
+        if (lost_track) {
+            actuate_req_t req = {
+                .kind = ACT_REACQUIRE,
+                .bearing = lost_track->x[0],
+            };
+            xQueueSend(actuate_q, &req, portMAX_DELAY);
+        }
+        power_observe(f->t_max, f->ta, f->state);
+        pipeline_end(stage, t0);
+        xQueueSend(alert_q, &f, portMAX_DELAY);
+    }
+}
+
+// Everything that goes out: alerts, the image while alarmed, status, heartbeat, telemetry.
+static void alert_stage(void *arg) {
+    int stage = (intptr_t)arg;
+    while (1) {
+        frame_slot_t *f;
+        xQueueReceive(alert_q, &f, portMAX_DELAY);
+        perf_mark_t t0 = pipeline_begin();
+        const track_t *hottest_track = f->has_track ? &f->hottest : NULL;
+        int blob_px = f->num_hotspots ? f->hotspots[0].size : 0;
+        uint8_t state = f->state;
+        if (state == FP_STATE_WARNING) {
+            DLOG(DLOG_WARN, "WARNING: growing hotspot at %.1f deg, peak=%.1f\t\n", hottest_track->x[0], hottest_track->x[2]);
+            send_alert(FP_STATE_WARNING, hottest_track->x[2], hottest_track->x[0], blob_px, hottest_track);
+        }
+        if (state == FP_STATE_FIRE) {
             // based on observation, flame from lighter was about 147 degrees C
             // for safety, we will set the threshold to 130 degrees C
             // we know this will not conflict with body temp or LA summer temps (highest LA summer temp is 54.4)
-            
+            // actuate doesn't move the head while this lasts, so the next frames look at it again
             gpio_set_level(GREEN_LED_PIN,0);
-
-            // stop moving motor
-            // just wont take step here
-
-            // send wireless message
-            sprintf(message, "FIRE\tFIRE\tFIRE\n");   ///////////////////////CHANGE THIS TO WIRELESS TRANSMIT
-            print_msg(message);
-            sprintf(message,"FIRE DETECTED\t\n");
-            esp_now_send(receiver_mac,(uint8_t*)message, sizeof(message));
-            // blink LED lights x6
-            toggleLED();
-
-            // check if fire is still there -- ie updating t_max by taking another picture of the same location
-            MLX90640_GetImage(mlx90640Frame, &mlx90640, mlx90640Image_compare);
-            MLX90640_GetFrameData(DEVICE_ADDR, mlx90640Frame);
-            float ta = MLX90640_GetTa(mlx90640Frame, &mlx90640);
-            MLX90640_CalculateTo(mlx90640Frame, &mlx90640, 0.95, ta-8, mlx90640Image_compare);  
-            float t_max_new=-1000; 
-            float t_min_new=1000;
-            for (uint8_t h=0; h<24; h++) {
-                for (uint8_t w=0; w<32; w++) {
-                    float t = mlx90640Image_compare[h*32 + w];
-                    if(t>t_max_new) t_max_new=t;
-                    if(t<t_min_new) t_min_new=t;
-                }
+            DLOG(DLOG_ERROR, "FIRE\tFIRE\tFIRE\n");
+            send_alert(FP_STATE_FIRE, f->t_max, hottest_track ? hottest_track->x[0] : f->t_max_bearing, blob_px,
+                       hottest_track);
+        } else {
+            gpio_set_level(GREEN_LED_PIN,1);
+        }
+        // operators get the actual image while something is wrong, or always if they asked --
+        // unless the black box is dumping, which sends the same frames
+        if ((state != FP_STATE_OK || frame_stream_enabled()) && !blackbox_sending()) {
+            frame_stream_send(f->image, f->head_bearing);
+        }
+        // every frame goes in, after the alerts so they aren't held up; an alarm freezes the
+        // run-up and starts the dump
+        blackbox_add(f->image, &f->tag, f->head_bearing, f->t_max, state);
+
+        frames_processed++;
+        if (frames_processed % TELEMETRY_EVERY_N_FRAMES == 0) {
+            // in sentinel the radio only wakes for heartbeats and alerts
+            if (power_get_mode() == POWER_MODE_FULL) {
+                fp_telemetry_t telemetry = {
+                    .frames = frames_processed,
+                    .frame_ms = (esp_timer_get_time() - f->started_us) / 1000,
+                    .tiles_calc = __builtin_popcountll(f->calc_tiles),
+                    .tracks = f->confirmed_tracks,
+                    .tx_fail = wireless_tx_failures(),
+                    .ta = fp_deci(f->ta),
+                };
+                wireless_send(FP_MSG_TELEMETRY, &telemetry, sizeof(telemetry));
+                wireless_send_link_stats();
+                #ifdef RELAY_MODE
+                relay_send_stats();
+                #endif
+                sched_send_stats();
             }
-            t_max = t_max_new;  // if t_max_new is still >=130, the loop will just continue
+            scan_stats_t scan_stats;
+            scan_get_stats(&scan_stats);
+            DLOG(DLOG_INFO, "scan: %.1f positions/min, %lu accepted, %lu subpages discarded, worst revisit %.1fs\n",
+                 scan_stats.positions_per_min, (unsigned long)scan_stats.accepted,
+                 (unsigned long)scan_stats.discarded, sched_worst_revisit_ms() / 1000.0f);
+            pipeline_print_stats();
+            perf_print_probes();
+        }
+
+        fp_status_t status = {
+            .state = state,
+            .pos = f->tag.pos,
+            .t_max = fp_deci(f->t_max),
+            .t_min = fp_deci(f->t_min),
+            .ta = fp_deci(f->ta),
+            .t_max_bearing = fp_cdeg(f->t_max_bearing),
+        };
+        // "no fire" every frame is just noise, the heartbeat says we're alive
+        int64_t now = esp_timer_get_time();
+        if (state != FP_STATE_OK || state != last_sent_state) {
+            if (wireless_send(FP_MSG_STATUS, &status, sizeof(status)) == ESP_OK) last_sent_state = state;
+        }
+        if (now - last_heartbeat_us >= HEARTBEAT_PERIOD_S * 1000000LL) {
+            fp_heartbeat_t hb = {
+                .uptime_s = now / 1000000,
+                .state = state,
+                .period_s = HEARTBEAT_PERIOD_S,
+            };
+            if (wireless_send(FP_MSG_HEARTBEAT, &hb, sizeof(hb)) == ESP_OK) last_heartbeat_us = now;
+        }
+        pipeline_end(stage, t0);
+        if (frames_processed == 1) {
+            boot_mark("first detection");
+            boot_print();
+        }
+        // blink LED lights x6 -- after the budget, it's a fixed 1.2 s on purpose
+        if (state == FP_STATE_FIRE) toggleLED();
+        xQueueSend(free_q, &f, portMAX_DELAY);
+    }
+}
+
+// Runs the reciever's commands one at a time, in the order they came in; ones that arrive
+// meanwhile wait in wireless_esp's queue. A panorama dump waits for room in the bulk queue
+// and can take seconds; the map keeps being updated while it goes out.
+static void command_task(void *arg) {
+    while (1) {
+        switch (wireless_take_command(portMAX_DELAY)) {
+            case FP_CMD_SEND_PANO:
+                panorama_send_map();
+                break;
+            case FP_CMD_STREAM_ON:
+                frame_stream_set_enabled(true);
+                break;
+            case FP_CMD_STREAM_OFF:
+                frame_stream_set_enabled(false);
+                break;
+            case FP_CMD_SEND_PERF:
+                perf_send_stats();
+                break;
+            case FP_CMD_BLACKBOX:
+                blackbox_trigger();
+                break;
         }
-        sprintf(message,"no fire: all is good\t\n\n\n\n\n\n");
-        esp_now_send(receiver_mac,(uint8_t*)message, sizeof(message));
-        step_motor();
-        vTaskDelay(pdMS_TO_TICKS(1000));
     }
 }
 
+// Sends a warning/fire alert. Confidence is a rough 0-100: how far past its threshold the
+// peak is, plus a bonus once the tracker has confirmed the hotspot over several frames.
+static void send_alert(uint8_t level, float peak, float bearing, int blob_px, const track_t *track) {
+    float threshold = (level == FP_STATE_FIRE) ? FIRE_THRESHOLD_C : TRACK_GROWING_MIN_C;
+    float confidence = 50.0f + 50.0f * (peak - threshold) / threshold;
+    if (confidence > 80.0f) confidence = 80.0f;
+    if (confidence < 0.0f) confidence = 0.0f;
+    if (track && track->hits >= TRACK_CONFIRM_HITS) confidence += 20.0f;
+
+    fp_alert_t alert = {
+        .level = level,
+        .confidence = (uint8_t)confidence,
+        .track_id = track ? track->id : 0,
+        .track_class = track ? track->cls : TRACK_UNKNOWN,
+        .peak = fp_deci(peak),
+        .bearing = fp_cdeg(bearing),
+        .blob_px = blob_px,
+    };
+    wireless_send(FP_MSG_ALERT, &alert, sizeof(alert));
+}
+
+// runs the denoising filter picked at the top of the file, if any
+static void denoise(float *image) {
+    #if defined(DENOISE_MEDIAN)
+    thermal_median3x3(image, NUM_ROWS, NUM_COLS);
+    #elif defined(DENOISE_GAUSSIAN)
+    thermal_gaussian3x3(image, NUM_ROWS, NUM_COLS);
+    #endif
+}
+
 void uart_init() {
     // Configure UART parameters
     uart_config_t uart_config = {
@@ -274,72 +777,54 @@ void toggleLED(void){
     vTaskDelay(pdMS_TO_TICKS(200));
 }
 
-// when data is sent
-void on_data_sent(const uint8_t *mac_addr, esp_now_send_status_t status) {
-    ESP_LOGI(TAG, "Send Status: %s", status == ESP_NOW_SEND_SUCCESS ? "Success" : "Fail");
-}
-
-
 void step_motor() {
-    char message[100];
     if (curr_pos == 0 && prev_pos == 0) {
-        sprintf(message, "initial step: ccw\n");
-        print_msg(message);
+        DLOG(DLOG_INFO, "initial step: ccw\n");
         step_ccw();
     } else if(curr_pos < prev_pos){
-        sprintf(message, "changing direction: stepping ccw\n");
-        print_msg(message);
+        DLOG(DLOG_INFO, "changing direction: stepping ccw\n");
         step_ccw();
     }
     else if (curr_pos > prev_pos){
-        sprintf(message, "changing direction: stepping cw\n");
-        print_msg(message);
+        DLOG(DLOG_INFO, "changing direction: stepping cw\n");
         step_cw();
     }
 }
 
 void step_ccw(){
-    char message[100];
-    if(curr_pos ==-3){
-        prev_pos = -4;
-        gpio_set_level(DIR_PIN,1);
+    if(curr_pos == SCAN_MIN_POS){
+        prev_pos = SCAN_MIN_POS - 1;
         step_cw();
         return;
     }
-    sprintf(message, "curr pos (ccw): %d", curr_pos);
-    print_msg(message);
-    gpio_set_level(STEP_PIN,0);
-    gpio_set_level(DIR_PIN,0);
-    for(int i = 0; i<70;i++){
-        gpio_set_level(STEP_PIN,1);
-        vTaskDelay(pdMS_TO_TICKS(10));
-        gpio_set_level(STEP_PIN,0);
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
+    DLOG(DLOG_INFO, "curr pos (ccw): %d", curr_pos);
+    // returns right away, the pulses run in the background
+    head_move_to_pos(curr_pos - 1);
     prev_pos = curr_pos;
     curr_pos--;
     return;
 }
 
 void step_cw(){
-    char message[100];
-    if(curr_pos ==3){
-        prev_pos = 4;
+    if(curr_pos == SCAN_MAX_POS){
+        prev_pos = SCAN_MAX_POS + 1;
         step_ccw();
         return;
     }
-    sprintf(message, "curr pos (cw): %d", curr_pos);
-    print_msg(message);
-    gpio_set_level(STEP_PIN,0);
-    gpio_set_level(DIR_PIN,1);
-    for(int i = 0; i<70;i++){
-        gpio_set_level(DIR_PIN,1);
-        gpio_set_level(STEP_PIN,1);
-        vTaskDelay(pdMS_TO_TICKS(10));
-        gpio_set_level(STEP_PIN,0);
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
+    DLOG(DLOG_INFO, "curr pos (cw): %d", curr_pos);
+    head_move_to_pos(curr_pos + 1);
     prev_pos = curr_pos;
     curr_pos++;
     return;
 }
+
+// straight to any scan position, for the scheduler
+void step_to(int pos){
+    if (pos < SCAN_MIN_POS) pos = SCAN_MIN_POS;
+    if (pos > SCAN_MAX_POS) pos = SCAN_MAX_POS;
+    if (pos == curr_pos) return;
+    DLOG(DLOG_INFO, "curr pos: %d -> %d\n", curr_pos, pos);
+    head_move_to_pos(pos);
+    prev_pos = curr_pos;
+    curr_pos = pos;
+}
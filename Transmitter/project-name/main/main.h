@@ -22,13 +22,28 @@
 // I2C Configuration
 #define I2C_MASTER_SCL_IO 22
 #define I2C_MASTER_SDA_IO 21
-#define I2C_MASTER_FREQ_HZ 100000
+#define I2C_MASTER_FREQ_HZ 400000    // EEPROM reads are fine at 400 kHz too (the 1 MHz FM+ mode is RAM only)
 #define I2C_MASTER_PORT I2C_NUM_0
 #define DEVICE_ADDR 0x33
 
 // Sensor Configuration
 #define NUM_ROWS 24
 #define NUM_COLS 32
+#define SENSOR_FOV_H_DEG 55.0f      // MLX90640BAB is 55x35 deg, the BAA variant is 110x75
+#define SENSOR_FOV_V_DEG 35.0f
+//#define SENSOR_MIRRORED             // uncomment if column 0 is on the right when looking out of the lens
+
+// Scan Geometry -- positions either side of home, the rest (step size, limits, bearing) is in head.h
+#ifdef CONFIG_HEAD_POSITIONS_EACH_SIDE
+#define SCAN_MAX_POS CONFIG_HEAD_POSITIONS_EACH_SIDE
+#else
+#define SCAN_MAX_POS 3
+#endif
+#define SCAN_MIN_POS (-SCAN_MAX_POS)
+
+// Detection
+#define PYRAMID_HOT_DELTA 100       // raw counts a tile's max must be above the frame mean to get a blob search
+                                    // (every changed tile is calibrated), check the hit rate with RUN_BENCHMARKS
 
 // Important Register Definitions
 #define STATUS_REG 0x8000
@@ -43,10 +58,10 @@ void i2c_write(uint16_t data, uint16_t reg);
 
 void print_arr(int *arr, int rows, int cols);
 void toggleLED();
-void on_data_sent(const uint8_t *mac_addr, esp_now_send_status_t status);
 void step_motor();
 void step_ccw();
 void step_cw();
+void step_to(int pos);
 
 
 #endif // MAIN_H
\ No newline at end of file
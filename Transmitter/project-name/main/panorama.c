@@ -0,0 +1,81 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "main.h"
+#include "wireless_esp.h"
+#include "panorama.h"
+
+// blended temperature of every cell, only valid where pano_hits[col] > 0
+static float pano[PANO_ROWS][PANO_COLS];
+// number of captures that have covered each column (saturates at 255)
+static uint8_t pano_hits[PANO_COLS];
+
+static int wrap_col(int col) {
+    col %= PANO_COLS;
+    if (col < 0) col += PANO_COLS;
+    return col;
+}
+
+void panorama_init(void) {
+    memset(pano, 0, sizeof(pano));
+    memset(pano_hits, 0, sizeof(pano_hits));
+}
+
+// Resamples the frame onto every panorama column it covers and blends it into the map.
+// A column's first capture is taken as-is, after that each capture is averaged in with a
+// weight of 1/(hits+1) that bottoms out at PANO_BLEND_MIN, so the map settles quickly but
+// still follows the scene when something changes.
+void panorama_add_frame(const float *image, float head_bearing) {
+    float deg_per_px = SENSOR_FOV_H_DEG / NUM_COLS;
+    float left = head_bearing - SENSOR_FOV_H_DEG / 2.0f;   // left edge of pixel column 0
+    float right = head_bearing + SENSOR_FOV_H_DEG / 2.0f;
+
+    int k_first = (int)ceilf(left / PANO_DEG_PER_COL - 0.5f);
+    int k_last = (int)floorf(right / PANO_DEG_PER_COL - 0.5f);
+
+    for (int k = k_first; k <= k_last; k++) {
+        // position of the cell centre in pixel coordinates (pixel centres at 0..NUM_COLS-1)
+        float x = ((k + 0.5f) * PANO_DEG_PER_COL - left) / deg_per_px - 0.5f;
+        if (x < 0) x = 0;
+        if (x > NUM_COLS - 1) x = NUM_COLS - 1;
+        int x0 = (int)x;
+        int x1 = (x0 < NUM_COLS - 1) ? x0 + 1 : x0;
+        float frac = x - x0;
+        #ifdef SENSOR_MIRRORED
+        x0 = NUM_COLS - 1 - x0;
+        x1 = NUM_COLS - 1 - x1;
+        #endif
+
+        int c = wrap_col(k);
+        float w = 1.0f / (pano_hits[c] + 1);
+        if (w < PANO_BLEND_MIN) w = PANO_BLEND_MIN;
+
+        for (int r = 0; r < PANO_ROWS; r++) {
+            float t = image[r*NUM_COLS + x0] * (1.0f - frac) + image[r*NUM_COLS + x1] * frac;
+            pano[r][c] += (t - pano[r][c]) * w;
+        }
+        if (pano_hits[c] < 255) pano_hits[c]++;
+    }
+}
+
+// Sends the whole map as FP_MSG_PANO runs of up to FP_PANO_MAX_CELLS cells, two per row.
+// That's more packets than the bulk queue holds, so this waits for room as it goes.
+void panorama_send_map(void) {
+    uint8_t buf[FP_MAX_PAYLOAD];
+    fp_pano_t *run = (fp_pano_t *)buf;
+    for (int r = 0; r < PANO_ROWS; r++) {
+        for (int c0 = 0; c0 < PANO_COLS; c0 += FP_PANO_MAX_CELLS) {
+            int count = PANO_COLS - c0;
+            if (count > FP_PANO_MAX_CELLS) count = FP_PANO_MAX_CELLS;
+            run->row = r;
+            run->col = c0;
+            run->count = count;
+            for (int i = 0; i < count; i++) {
+                run->cells[i] = pano_hits[c0 + i] ? fp_deci(pano[r][c0 + i]) : FP_PANO_UNSEEN;
+            }
+            wireless_send_wait(FP_MSG_PANO, run, sizeof(fp_pano_t) + count * sizeof(int16_t), pdMS_TO_TICKS(100));
+        }
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef PANORAMA_H
+#define PANORAMA_H
+
+#include <stdint.h>
+#include "main.h"
+
+// Cylindrical map of everything the head has looked at.
+// Columns are world bearing (see head_steps_bearing, increasing cw),
+// rows are the sensor rows (elevation), since the head only turns about one axis.
+#define PANO_DEG_PER_COL 2.0f
+#define PANO_COLS 180               // 360 / PANO_DEG_PER_COL
+#define PANO_ROWS NUM_ROWS
+#define PANO_BLEND_MIN 0.25f        // weight of a new capture once a column has been seen a few times
+
+// Function Declarations
+void panorama_init(void);
+void panorama_add_frame(const float *image, float head_bearing);
+void panorama_send_map(void);
+
+#endif // PANORAMA_H
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "fire_protocol.h"
+#include "wireless_esp.h"
+#include "main.h"
+#include "pipeline.h"
+#include "perf.h"
+
+#define PERF_PROBE_NAME(name, deadline) #name,
+#define PERF_PROBE_DEADLINE(name, deadline) deadline,
+static const char *const probe_names[PERF_NUM_PROBES] = { PERF_PROBES(PERF_PROBE_NAME) };
+static const uint32_t probe_deadlines[PERF_NUM_PROBES] = { PERF_PROBES(PERF_PROBE_DEADLINE) };
+
+static perf_timer_t probes[PERF_NUM_PROBES];
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;     // probes get hit from several tasks
+
+void perf_init(void) {
+    for (int i = 0; i < PERF_NUM_PROBES; i++) perf_timer_init(&probes[i], probe_names[i], probe_deadlines[i]);
+}
+
+void perf_timer_init(perf_timer_t *t, const char *name, uint32_t deadline_us) {
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    t->deadline_us = deadline_us;
+}
+
+// records the time since started
+void perf_timer_add(perf_timer_t *t, perf_mark_t started) {
+    int64_t d = perf_now().us - started.us;
+    uint32_t us = d > UINT32_MAX ? UINT32_MAX : (uint32_t)d;
+    int b = us ? 31 - __builtin_clz(us) : 0;
+    portENTER_CRITICAL_SAFE(&lock);
+    t->buckets[b < PERF_BUCKETS ? b : PERF_BUCKETS - 1]++;
+    t->count++;
+    t->total_us += us;
+    if (us > t->max_us) t->max_us = us;
+    if (us > t->deadline_us) t->misses++;
+    portEXIT_CRITICAL_SAFE(&lock);
+}
+
+// consistent copy of a timer that other tasks may be adding to
+void perf_snapshot(const perf_timer_t *t, perf_timer_t *out) {
+    portENTER_CRITICAL_SAFE(&lock);
+    *out = *t;
+    portEXIT_CRITICAL_SAFE(&lock);
+}
+
+void perf_probe(int probe, perf_mark_t started) {
+    if (probe >= 0 && probe < PERF_NUM_PROBES) perf_timer_add(&probes[probe], started);
+}
+
+const perf_timer_t *perf_get_probe(int probe) {
+    return (probe >= 0 && probe < PERF_NUM_PROBES) ? &probes[probe] : NULL;
+}
+
+// upper edge of the bucket the pct-th percentile falls in, so it's never an underestimate
+// (but can be up to 2x over); capped at the max seen
+uint32_t perf_percentile_us(const perf_timer_t *t, int pct) {
+    if (t->count == 0) return 0;
+    uint32_t want = ((uint64_t)t->count * pct + 99) / 100;
+    uint32_t seen = 0;
+    for (int b = 0; b < PERF_BUCKETS; b++) {
+        seen += t->buckets[b];
+        if (seen >= want) {
+            uint32_t edge = (b < 31) ? (2u << b) - 1 : UINT32_MAX;
+            return edge < t->max_us ? edge : t->max_us;
+        }
+    }
+    return t->max_us;
+}
+
+void perf_print(const perf_timer_t *timer) {
+    char message[160];
+    perf_timer_t snap;
+    const perf_timer_t *t = &snap;
+    perf_snapshot(timer, &snap);
+    sprintf(message, "%-10s %6lu, avg %7.2fms p50 <%7.2fms p99 <%7.2fms max %7.2fms, %lu over %.1fms\n",
+            t->name, (unsigned long)t->count, t->count ? t->total_us / 1000.0 / t->count : 0.0,
+            perf_percentile_us(t, 50) / 1000.0, perf_percentile_us(t, 99) / 1000.0, t->max_us / 1000.0,
+            (unsigned long)t->misses, t->deadline_us / 1000.0);
+    print_msg(message);
+}
+
+void perf_print_probes(void) {
+    for (int i = 0; i < PERF_NUM_PROBES; i++) perf_print(&probes[i]);
+}
+
+static void fill_entry(fp_perf_entry_t *e, const perf_timer_t *timer) {
+    perf_timer_t snap;
+    const perf_timer_t *t = &snap;
+    perf_snapshot(timer, &snap);
+    memset(e, 0, sizeof(*e));
+    strncpy(e->name, t->name, sizeof(e->name));
+    e->count = t->count;
+    e->misses = t->misses > UINT16_MAX ? UINT16_MAX : t->misses;
+    e->deadline_us = t->deadline_us;
+    e->max_us = t->max_us;
+    e->p50_us = perf_percentile_us(t, 50);
+    e->p99_us = perf_percentile_us(t, 99);
+}
+
+// Sends every pipeline stage and probe, as many per message as fit. Answers FP_CMD_SEND_PERF.
+esp_err_t perf_send_stats(void) {
+    int stages = pipeline_num_stages();
+    int total = stages + PERF_NUM_PROBES;
+    esp_err_t err = ESP_OK;
+    for (int first = 0; first < total; first += FP_PERF_MAX_ENTRIES) {
+        uint8_t buf[FP_MAX_PAYLOAD];
+        fp_perf_t *msg = (fp_perf_t *)buf;
+        int n = total - first < FP_PERF_MAX_ENTRIES ? total - first : FP_PERF_MAX_ENTRIES;
+        msg->first = first;
+        msg->total = total;
+        msg->count = n;
+        for (int i = 0; i < n; i++) {
+            int k = first + i;
+            fill_entry(&msg->entries[i], k < stages ? pipeline_get_timer(k) : &probes[k - stages]);
+        }
+        esp_err_t e = wireless_send(FP_MSG_PERF, msg, sizeof(fp_perf_t) + n * sizeof(fp_perf_entry_t));
+        if (e != ESP_OK) err = e;
+    }
+    return err;
+}
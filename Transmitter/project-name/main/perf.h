@@ -0,0 +1,66 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+
+// Lightweight timing for the sensing loop, cheap enough to leave on: a timestamp is one
+// esp_timer_get_time (about a microsecond), recording a sample is a subtraction, a count-
+// leading-zeros and a few adds under a spinlock. At ~10 samples per frame and ~1 frame a
+// second that's well under 0.01% of the CPU.
+//
+// Every timer keeps a log2 histogram in microseconds (bucket b counts [2^b, 2^(b+1)) us, the
+// last bucket everything longer), its max and total, and how often it went past its
+// deadline. The pipeline stages each have one (pipeline.c); the probes below time the steps
+// inside them. perf_send_stats puts a summary of all of them on the radio (FP_MSG_PERF).
+//
+// Not the CPU cycle counter: with power management on (power.c) the clock switches between
+// 240 and 80 MHz and the counter stops in light sleep, so cycles don't convert to time.
+// esp_timer keeps counting through both and is the same on either core.
+#define PERF_BUCKETS 24                 // up to 2^23 us = 8.4 s
+
+// probes: name, deadline (us)
+#define PERF_PROBES(PROBE) \
+    PROBE(get_frame, 1100000)   /* MLX90640_GetFrameData, including the wait for a subpage */ \
+    PROBE(calculate, 40000)     /* MLX90640_CalculateToTiles */ \
+    PROBE(reduce, 1000)         /* t_max / t_min over the image */ \
+    PROBE(radio_send, 2000)     /* esp_now_send */ \
+    PROBE(motor, 1000)          /* starting a move */ \
+    PROBE(blackbox, 5000)       /* blackbox_add: encoding the frame into the ring */
+
+#define PERF_PROBE_ID(name, deadline) PERF_##name,
+enum { PERF_PROBES(PERF_PROBE_ID) PERF_NUM_PROBES };
+
+typedef struct {
+    const char *name;
+    uint32_t deadline_us;
+    uint32_t count;
+    uint32_t misses;                    // samples over deadline_us
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t buckets[PERF_BUCKETS];
+} perf_timer_t;
+
+typedef struct {
+    int64_t us;
+} perf_mark_t;
+
+static inline perf_mark_t perf_now(void) {
+    perf_mark_t m = { esp_timer_get_time() };
+    return m;
+}
+
+// Function Declarations
+void perf_init(void);
+void perf_timer_init(perf_timer_t *t, const char *name, uint32_t deadline_us);
+void perf_timer_add(perf_timer_t *t, perf_mark_t started);
+void perf_snapshot(const perf_timer_t *t, perf_timer_t *out);
+void perf_probe(int probe, perf_mark_t started);
+const perf_timer_t *perf_get_probe(int probe);
+uint32_t perf_percentile_us(const perf_timer_t *t, int pct);
+void perf_print(const perf_timer_t *t);
+void perf_print_probes(void);
+esp_err_t perf_send_stats(void);
+
+#endif // PERF_H
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include "main.h"
+#include "pipeline.h"
+
+static const pipeline_stage_t *stages;
+static int num_stages = 0;
+static TaskHandle_t tasks[PIPELINE_MAX_STAGES];
+static perf_timer_t timers[PIPELINE_MAX_STAGES];
+
+// Creates every stage's task from its static stack and TCB. The queues have to exist before
+// this, a stage may start using them straight away.
+void pipeline_start(const pipeline_stage_t *stage_list, int count) {
+    stages = stage_list;
+    num_stages = count < PIPELINE_MAX_STAGES ? count : PIPELINE_MAX_STAGES;
+    for (int i = 0; i < num_stages; i++) {
+        const pipeline_stage_t *s = &stages[i];
+        perf_timer_init(&timers[i], s->name, s->budget_us);
+        tasks[i] = xTaskCreateStaticPinnedToCore(s->fn, s->name, s->stack_bytes, (void *)(intptr_t)i,
+                                                 s->priority, s->stack, s->tcb, s->core);
+    }
+}
+
+int pipeline_num_stages(void) {
+    return num_stages;
+}
+
+TaskHandle_t pipeline_task(int stage) {
+    return (stage >= 0 && stage < num_stages) ? tasks[stage] : NULL;
+}
+
+perf_mark_t pipeline_begin(void) {
+    return perf_now();
+}
+
+// counts one item for this stage, over budget counts as a deadline miss
+void pipeline_end(int stage, perf_mark_t started) {
+    if (stage < 0 || stage >= num_stages) return;
+    perf_timer_add(&timers[stage], started);
+}
+
+const perf_timer_t *pipeline_get_timer(int stage) {
+    return &timers[stage];
+}
+
+// bytes of the stage's stack never touched so far
+uint32_t pipeline_stack_free(int stage) {
+    return tasks[stage] ? uxTaskGetStackHighWaterMark(tasks[stage]) : 0;
+}
+
+void pipeline_print_stats(void) {
+    char message[60];
+    for (int i = 0; i < num_stages; i++) {
+        perf_print(&timers[i]);
+        sprintf(message, "           %lu B stack free\n", (unsigned long)pipeline_stack_free(i));
+        print_msg(message);
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "perf.h"
+
+// Tiny framework for running the firmware as a fixed set of tasks (stages) joined by queues,
+// all allocated statically: nothing here touches the heap, before or after boot.
+//
+// The wiring is a list macro with one STAGE(name, entry, stack, priority, core, budget) line
+// per stage, e.g. MY_PIPELINE(STAGE) expanding to STAGE(acquire, acquire_stage, 3072, 6, 1, 5000)
+// STAGE(detect, detect_stage, 6144, 4, 1, 40000). Then
+//
+//     MY_PIPELINE(PIPELINE_DECLARE)                   // prototypes, stacks and TCBs
+//     enum { MY_PIPELINE(PIPELINE_ID) NUM_STAGES };   // STAGE_acquire, STAGE_detect, ...
+//     static const pipeline_stage_t stages[] = { MY_PIPELINE(PIPELINE_ENTRY) };
+//
+// and the queues between them are PIPELINE_QUEUE(name, item type, depth) at file scope plus
+// PIPELINE_QUEUE_INIT(name) before pipeline_start. Each stage's task gets its own index as
+// the argument and brackets the work on each item with pipeline_begin/pipeline_end, which
+// adds it to the stage's perf timer with the time budget as its deadline. main.c's FIRE_PIPELINE is the real example.
+
+// name, entry function, stack (bytes), priority, core, time budget per item (us)
+#define PIPELINE_DECLARE(name, fn, stack, prio, core, budget) \
+    static void fn(void *arg); \
+    static StackType_t name##_stack[stack]; \
+    static StaticTask_t name##_tcb;
+#define PIPELINE_ID(name, fn, stack, prio, core, budget) STAGE_##name,
+#define PIPELINE_ENTRY(name, fn, stack, prio, core, budget) \
+    { #name, fn, sizeof(name##_stack), prio, core, budget, name##_stack, &name##_tcb },
+
+#define PIPELINE_QUEUE(name, type, depth) \
+    enum { name##_depth = (depth), name##_item_size = sizeof(type) }; \
+    static uint8_t name##_storage[(depth) * sizeof(type)]; \
+    static StaticQueue_t name##_buffer; \
+    static QueueHandle_t name;
+#define PIPELINE_QUEUE_INIT(name) \
+    name = xQueueCreateStatic(name##_depth, name##_item_size, name##_storage, &name##_buffer)
+
+#define PIPELINE_MAX_STAGES 8
+
+typedef struct {
+    const char *name;
+    TaskFunction_t fn;
+    uint32_t stack_bytes;           // StackType_t is a byte on the ESP32 port
+    UBaseType_t priority;
+    BaseType_t core;
+    uint32_t budget_us;             // time an item may take between pipeline_begin and _end
+    StackType_t *stack;
+    StaticTask_t *tcb;
+} pipeline_stage_t;
+
+// Function Declarations
+void pipeline_start(const pipeline_stage_t *stages, int count);
+int pipeline_num_stages(void);
+TaskHandle_t pipeline_task(int stage);
+perf_mark_t pipeline_begin(void);
+void pipeline_end(int stage, perf_mark_t started);
+const perf_timer_t *pipeline_get_timer(int stage);
+uint32_t pipeline_stack_free(int stage);
+void pipeline_print_stats(void);
+
+#endif // PIPELINE_H
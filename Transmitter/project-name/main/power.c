@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_pm.h"
+#include "esp_now.h"
+#include "esp_wifi.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "fire_protocol.h"
+#include "wireless_esp.h"
+#include "main.h"
+#include "dlog.h"
+#include "power.h"
+
+static power_mode_t mode = POWER_MODE_FULL;     // full rate through boot and the first POWER_CALM_S
+static int64_t mode_since_us;
+static int64_t time_us[2];
+static int64_t last_warm_us;
+static int64_t last_frame_us;
+static int64_t last_report_us;
+static uint32_t escalations = 0;
+static uint16_t ma_x10[2] = { POWER_EST_MA_FULL, POWER_EST_MA_SENTINEL };
+static bool measured = false;
+static bool radio_always_on = false;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t wake;          // cuts a sentinel wait short when we go to full rate
+static StaticSemaphore_t wake_buf;
+
+// measured currents from NVS replace the estimates, both are needed
+static void load_measured(void) {
+    nvs_handle_t nvs;
+    if (nvs_open("power", NVS_READONLY, &nvs) != ESP_OK) return;
+    int32_t full, sentinel;
+    if (nvs_get_i32(nvs, "ma_full", &full) == ESP_OK && full > 0 &&
+        nvs_get_i32(nvs, "ma_sentinel", &sentinel) == ESP_OK && sentinel > 0) {
+        ma_x10[POWER_MODE_FULL] = full;
+        ma_x10[POWER_MODE_SENTINEL] = sentinel;
+        measured = true;
+    }
+    nvs_close(nvs);
+}
+
+// call after nvs_flash_init and wifi_init
+esp_err_t power_init(void) {
+    load_measured();
+    wake = xSemaphoreCreateBinaryStatic(&wake_buf);
+    mode_since_us = last_warm_us = last_report_us = esp_timer_get_time();
+    #ifdef CONFIG_PM_ENABLE
+    // with the radio always listening (full rate) its PM lock keeps the CPU awake anyway,
+    // sleep only happens in sentinel
+    esp_pm_config_t pm = {
+        .max_freq_mhz = POWER_MAX_FREQ_MHZ,
+        .min_freq_mhz = POWER_MIN_FREQ_MHZ,
+        .light_sleep_enable = true,
+    };
+    return esp_pm_configure(&pm);
+    #else
+    print_msg("power: CONFIG_PM_ENABLE is off, sentinel mode won't put the CPU to sleep\n");
+    return ESP_OK;
+    #endif
+}
+
+// the radio keeps listening in sentinel too, only the frame rate drops
+void power_radio_always_on(void) {
+    radio_always_on = true;
+}
+
+power_mode_t power_get_mode(void) {
+    return mode;
+}
+
+static void set_radio(power_mode_t m) {
+    if (m == POWER_MODE_SENTINEL && !radio_always_on) {
+        esp_now_set_wake_window(POWER_WAKE_WINDOW_MS);
+        esp_wifi_connectionless_module_set_wake_interval(POWER_WAKE_INTERVAL_MS);
+        esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+    } else {
+        esp_wifi_set_ps(WIFI_PS_NONE);
+    }
+}
+
+static void set_mode(power_mode_t m) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&lock);
+    time_us[mode] += now - mode_since_us;
+    mode_since_us = now;
+    mode = m;
+    if (m == POWER_MODE_FULL) escalations++;
+    portEXIT_CRITICAL(&lock);
+    set_radio(m);
+    if (m == POWER_MODE_FULL) xSemaphoreGive(wake);
+    DLOG(DLOG_INFO, "power: %s\n", m == POWER_MODE_FULL ? "full rate, warm candidate" : "sentinel");
+    power_send_stats();
+}
+
+// Called with every frame's result (detect stage). Anything warm keeps us at full rate.
+void power_observe(float t_max, float ta, uint8_t state) {
+    int64_t now = esp_timer_get_time();
+    #ifdef POWER_SENTINEL
+    bool warm = state != FP_STATE_OK || t_max - ta >= POWER_WARM_DELTA_C;
+    if (warm) last_warm_us = now;
+    if (mode == POWER_MODE_SENTINEL && warm) {
+        set_mode(POWER_MODE_FULL);
+    } else if (mode == POWER_MODE_FULL && now - last_warm_us >= POWER_CALM_S * 1000000LL) {
+        set_mode(POWER_MODE_SENTINEL);
+    }
+    #endif
+    if (now - last_report_us >= POWER_REPORT_S * 1000000LL) power_send_stats();
+}
+
+// Blocks until the next frame is due: straight away at full rate, POWER_SENTINEL_FRAME_MS
+// after the last one in sentinel (or sooner if something sends us to full rate meanwhile).
+void power_wait_frame(void) {
+    if (mode == POWER_MODE_SENTINEL) {
+        int64_t now = esp_timer_get_time();
+        int64_t due = last_frame_us + POWER_SENTINEL_FRAME_MS * 1000LL;
+        if (now < due) xSemaphoreTake(wake, pdMS_TO_TICKS((due - now) / 1000) + 1);
+    }
+    xSemaphoreTake(wake, 0);    // a wake from while we weren't waiting
+    last_frame_us = esp_timer_get_time();
+}
+
+void power_get_stats(power_stats_t *stats) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&lock);
+    stats->mode = mode;
+    stats->escalations = escalations;
+    stats->time_us[0] = time_us[0];
+    stats->time_us[1] = time_us[1];
+    stats->time_us[mode] += now - mode_since_us;
+    portEXIT_CRITICAL(&lock);
+    stats->ma_x10[0] = ma_x10[0];
+    stats->ma_x10[1] = ma_x10[1];
+    stats->measured = measured;
+
+    int64_t total = stats->time_us[0] + stats->time_us[1];
+    stats->avg_ma_x10 = total > 0 ? (stats->time_us[0] * ma_x10[0] + stats->time_us[1] * ma_x10[1]) / total
+                                  : ma_x10[mode];
+    // mAh / mA, with avg in tenths of a mA
+    uint32_t usable_mah = POWER_BATTERY_MAH * POWER_BATTERY_USABLE_PCT / 100;
+    uint32_t hours = stats->avg_ma_x10 ? usable_mah * 10 / stats->avg_ma_x10 : 0;
+    stats->runtime_h = hours > UINT16_MAX ? UINT16_MAX : hours;
+}
+
+esp_err_t power_send_stats(void) {
+    power_stats_t st;
+    power_get_stats(&st);
+    last_report_us = esp_timer_get_time();
+    fp_power_t msg = {
+        .mode = st.mode,
+        .measured = st.measured,
+        .ma_full = st.ma_x10[POWER_MODE_FULL],
+        .ma_sentinel = st.ma_x10[POWER_MODE_SENTINEL],
+        .ma_avg = st.avg_ma_x10,
+        .full_s = st.time_us[POWER_MODE_FULL] / 1000000,
+        .sentinel_s = st.time_us[POWER_MODE_SENTINEL] / 1000000,
+        .escalations = st.escalations > UINT16_MAX ? UINT16_MAX : st.escalations,
+        .runtime_h = st.runtime_h,
+    };
+    return wireless_send(FP_MSG_POWER, &msg, sizeof(msg));
+}
@@ -0,0 +1,65 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+// Power modes for running off a battery bank.
+//
+// Full rate: frames back to back, radio listening all the time (the old behaviour).
+// Sentinel: one frame every POWER_SENTINEL_FRAME_MS. In between, every task is blocked, so
+// with CONFIG_PM_ENABLE and tickless idle the CPU drops into light sleep. The radio only
+// wakes for POWER_WAKE_WINDOW_MS every POWER_WAKE_INTERVAL_MS to listen, or to send
+// heartbeats and alerts. Telemetry isn't sent.
+//
+// The node goes to full rate as soon as a frame shows a warm candidate: a peak
+// POWER_WARM_DELTA_C above ambient, or anything but OK from the detector. It goes back to
+// sentinel after POWER_CALM_S without one. Commenting out POWER_SENTINEL keeps it at full rate.
+//
+// The currents below are ESTIMATES from the datasheets, not measurements: ESP32 + radio,
+// MLX90640, LEDs. The stepper driver isn't included. Measure each mode with a USB meter and
+// store the numbers in NVS (namespace "power", keys ma_full / ma_sentinel in 0.1 mA), then
+// FP_MSG_POWER reports them as measured.
+#define POWER_SENTINEL
+#define POWER_SENTINEL_FRAME_MS 3000    // less than HEARTBEAT_PERIOD_S, heartbeats go out with frames
+#define POWER_WARM_DELTA_C 15.0f        // people are ~10 above a room, a kettle or flame far more
+#define POWER_CALM_S 60
+#define POWER_WAKE_INTERVAL_MS 1000     // sentinel radio: listen this often...
+#define POWER_WAKE_WINDOW_MS 50         // ...for this long
+#define POWER_MAX_FREQ_MHZ 240
+#define POWER_MIN_FREQ_MHZ 80           // DFS floor, APB stays at 80 MHz for the UART/I2C
+
+#define POWER_EST_MA_FULL 1600          // 0.1 mA, estimate: 240 MHz with the radio always listening + sensor
+#define POWER_EST_MA_SENTINEL 450       // 0.1 mA, estimate: mostly light sleep, radio duty ~5% + sensor
+#define POWER_BATTERY_MAH 10000         // the power bank on the label
+#define POWER_BATTERY_USABLE_PCT 60     // what's left after the 3.7 -> 5 V boost and cutoff
+
+#define POWER_REPORT_S 600              // FP_MSG_POWER this often, and on every mode change
+
+typedef enum {
+    POWER_MODE_FULL = 0,
+    POWER_MODE_SENTINEL = 1,
+} power_mode_t;
+
+typedef struct {
+    power_mode_t mode;
+    uint32_t escalations;               // sentinel -> full
+    int64_t time_us[2];                 // in each mode since boot
+    uint16_t ma_x10[2];                 // per mode, measured if `measured`
+    bool measured;
+    uint16_t avg_ma_x10;                // time weighted over time_us
+    uint16_t runtime_h;                 // on the usable part of POWER_BATTERY_MAH at avg_ma_x10
+} power_stats_t;
+
+// Function Declarations
+esp_err_t power_init(void);
+void power_radio_always_on(void);
+power_mode_t power_get_mode(void);
+void power_observe(float t_max, float ta, uint8_t state);
+void power_wait_frame(void);
+void power_get_stats(power_stats_t *stats);
+esp_err_t power_send_stats(void);
+
+#endif // POWER_H
@@ -0,0 +1,130 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_wifi.h"
+#include "wireless_esp.h"
+#include "tx_queue.h"
+#include "relay.h"
+
+typedef struct {
+    uint8_t origin[ESP_NOW_ETH_ALEN];
+    uint16_t seq;
+    bool used;
+} msg_id_t;
+
+static bool enabled = false;
+static uint8_t own_mac[ESP_NOW_ETH_ALEN];
+static msg_id_t cache[RELAY_CACHE_SIZE];
+static int cache_next = 0;
+static relay_stats_t stats;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+void relay_init(void) {
+    memset(cache, 0, sizeof(cache));
+    memset(&stats, 0, sizeof(stats));
+    esp_wifi_get_mac(WIFI_IF_STA, own_mac);
+    enabled = true;
+}
+
+bool relay_enabled(void) {
+    return enabled;
+}
+
+// Checks the id against the cache and adds it if it's new. Returns true if we've had this
+// message before. Also used for broadcast commands, which reach us once per relay in range.
+bool relay_seen(const uint8_t *origin, uint16_t seq) {
+    for (int i = 0; i < RELAY_CACHE_SIZE; i++) {
+        if (cache[i].used && cache[i].seq == seq && memcmp(cache[i].origin, origin, ESP_NOW_ETH_ALEN) == 0) {
+            return true;
+        }
+    }
+    msg_id_t *m = &cache[cache_next];
+    cache_next = (cache_next + 1) % RELAY_CACHE_SIZE;
+    memcpy(m->origin, origin, ESP_NOW_ETH_ALEN);
+    m->seq = seq;
+    m->used = true;
+    return false;
+}
+
+// Called from on_data_recv (wifi task) for every packet. Adds or updates the relay trailer
+// and queues the packet for the transmit task, which stamps the time it spent here just
+// before handing it to the radio. Alerts go in the alert queue like our own.
+void relay_on_recv(const esp_now_recv_info_t *info, const uint8_t *data, int len, int64_t now_us) {
+    static uint8_t packet[FP_MAX_PACKET];
+    if (!enabled) return;
+    const fp_header_t *h = fp_parse(data, len);
+    if (h == NULL) return;
+
+    const fp_relay_t *in = fp_relay_info(h, len);
+    const uint8_t *origin = in ? in->origin : info->src_addr;
+    uint8_t ttl = in ? in->ttl : FP_DEFAULT_TTL;
+    uint8_t hops = in ? in->hops : 0;
+    uint16_t fwd = in ? in->fwd_100us : 0;
+
+    if (memcmp(origin, own_mac, ESP_NOW_ETH_ALEN) == 0 || relay_seen(origin, h->seq)) {
+        stats.duplicates++;
+        return;
+    }
+    if (ttl == 0) {
+        stats.ttl_expired++;
+        return;
+    }
+
+    size_t n = sizeof(fp_header_t) + h->len;
+    memcpy(packet, h, n);
+    ((fp_header_t *)packet)->flags |= FP_FLAG_RELAYED;
+    fp_relay_t *out = (fp_relay_t *)(packet + n);
+    memcpy(out->origin, origin, ESP_NOW_ETH_ALEN);
+    out->ttl = ttl - 1;
+    out->hops = hops + 1;
+    out->fwd_100us = fwd;
+    n += sizeof(fp_relay_t);
+
+    if (tx_queue_forward(packet, n, h->type, now_us) != ESP_OK) {
+        stats.queue_full++;
+    }
+}
+
+// Transmit task, right before the forwarded packet goes to the delivery layer: adds the time
+// since it arrived to the trailer, returns that time
+uint32_t relay_stamp(uint8_t *packet, size_t len, int64_t rx_us, int64_t now_us) {
+    const fp_header_t *h = (const fp_header_t *)packet;
+    fp_relay_t *r = (fp_relay_t *)fp_relay_info(h, len);
+    uint32_t us = now_us - rx_us;
+    if (r) {
+        uint32_t total = r->fwd_100us + (us + 50) / 100;
+        r->fwd_100us = total > UINT16_MAX ? UINT16_MAX : total;
+    }
+    return us;
+}
+
+// ... and once the delivery layer has taken it
+void relay_count_forwarded(uint32_t us) {
+    taskENTER_CRITICAL(&lock);
+    stats.forwarded++;
+    stats.latency_sum_us += us;
+    if (us > stats.latency_max_us) stats.latency_max_us = us;
+    taskEXIT_CRITICAL(&lock);
+}
+
+void relay_get_stats(relay_stats_t *out) {
+    taskENTER_CRITICAL(&lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&lock);
+}
+
+// FP_MSG_RELAY_STATS for the reciever, sent with the telemetry when relaying is on
+esp_err_t relay_send_stats(void) {
+    relay_stats_t st;
+    relay_get_stats(&st);
+    uint32_t avg = st.forwarded ? st.latency_sum_us / st.forwarded / 100 : 0;
+    uint32_t max = st.latency_max_us / 100;
+    fp_relay_stats_t msg = {
+        .forwarded = st.forwarded,
+        .duplicates = st.duplicates > UINT16_MAX ? UINT16_MAX : st.duplicates,
+        .ttl_expired = st.ttl_expired > UINT16_MAX ? UINT16_MAX : st.ttl_expired,
+        .queue_full = st.queue_full > UINT16_MAX ? UINT16_MAX : st.queue_full,
+        .latency_avg_100us = avg > UINT16_MAX ? UINT16_MAX : avg,
+        .latency_max_100us = max > UINT16_MAX ? UINT16_MAX : max,
+    };
+    return wireless_send(FP_MSG_RELAY_STATS, &msg, sizeof(msg));
+}
@@ -0,0 +1,35 @@
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_now.h"
+#include "fire_protocol.h"
+
+// Relay role: a detector that also passes on other detectors' messages towards the
+// reciever (and the reciever's commands back out), for floors too big for one hop.
+// Far detectors use the relay's MAC as their receiver_mac; the relay forwards to its own.
+// Every forwarded packet carries an fp_relay_t trailer (origin, ttl, hops, time spent in
+// relays). A cache of recently seen (origin, seq) pairs stops loops and duplicate copies.
+#define RELAY_CACHE_SIZE 64             // recent message ids, ~a few seconds of traffic
+
+typedef struct {
+    uint32_t forwarded;
+    uint32_t duplicates;
+    uint32_t ttl_expired;
+    uint32_t queue_full;
+    uint64_t latency_sum_us;            // receive -> handed to the delivery layer
+    uint32_t latency_max_us;
+} relay_stats_t;
+
+// Function Declarations
+void relay_init(void);
+bool relay_enabled(void);
+bool relay_seen(const uint8_t *origin, uint16_t seq);
+void relay_on_recv(const esp_now_recv_info_t *info, const uint8_t *data, int len, int64_t now_us);
+uint32_t relay_stamp(uint8_t *packet, size_t len, int64_t rx_us, int64_t now_us);
+void relay_count_forwarded(uint32_t latency_us);
+void relay_get_stats(relay_stats_t *stats);
+esp_err_t relay_send_stats(void);
+
+#endif // RELAY_H
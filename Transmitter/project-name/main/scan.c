@@ -0,0 +1,118 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "MLX90640_API.h"
+#include "MLX90640_I2C_Driver.h"
+#include "main.h"
+#include "stepper.h"
+#include "scheduler.h"
+#include "perf.h"
+#include "scan.h"
+
+extern int curr_pos;
+
+static uint32_t primed_seq = 0;     // stepper_moves() when the new-data flag was last cleared
+static bool primed_clean = true;    // the first subpage after that clear is usable
+static uint32_t accepted = 0;
+static uint32_t discarded = 0;
+static int64_t last_accept_us = 0;
+static uint32_t last_accept_seq = 0;
+static float cycle_ms = 0;
+
+void scan_init(void) {
+    primed_seq = stepper_moves();
+    primed_clean = true;
+    last_accept_us = 0;
+    cycle_ms = 0;
+}
+
+// Starts the move to wherever the scheduler wants to look next and returns straight away,
+// the head travels while the caller carries on with the frame it already has. Does nothing
+// while the scheduler wants more frames where the head is.
+void scan_start_move(void) {
+    #ifdef SCAN_ADAPTIVE
+    int next;
+    if (sched_next(curr_pos, &next)) step_to(next);
+    #else
+    step_motor();
+    #endif
+}
+
+// Waits for the sensor's new-data flag, looking every SCAN_POLL_MS. MLX90640_GetFrameData
+// would read the status register back to back for up to a whole subpage, keeping the CPU
+// (and the I2C bus) busy the entire time, with no chance to idle or sleep.
+static int wait_data_ready(void) {
+    uint16_t status;
+    while (1) {
+        int err = MLX90640_I2CRead(DEVICE_ADDR, STATUS_REG, 1, &status);
+        if (err != 0) return err;
+        if (status & 0x0008) return 0;
+        vTaskDelay(pdMS_TO_TICKS(SCAN_POLL_MS));
+    }
+}
+
+// Blocks until there's a subpage taken entirely at the current position and reads it into
+// frame_data. Returns what MLX90640_GetFrameData returned (the subpage number, or < 0).
+int scan_capture(uint16_t *frame_data, scan_tag_t *tag) {
+    uint8_t skipped = 0;
+    while (1) {
+        if (stepper_wait(pdMS_TO_TICKS(SCAN_MOVE_TIMEOUT_MS)) != ESP_OK || stepper_busy()) continue;
+        // stopped_us is only written by the move-done interrupt, safe to read once it's done
+        int64_t settled_us = stepper_stopped_us() + SCAN_SETTLE_MS * 1000LL;
+        int64_t now = esp_timer_get_time();
+        if (now < settled_us) vTaskDelay(pdMS_TO_TICKS((settled_us - now + 999) / 1000) + 1);
+
+        uint32_t seq = stepper_moves();
+        if (seq != primed_seq) {
+            // whatever is in the sensor now may have been taken on the way here
+            int64_t clear_us = esp_timer_get_time();
+            MLX90640_I2CWrite(DEVICE_ADDR, STATUS_REG, 0x0030);
+            primed_seq = seq;
+            primed_clean = clear_us >= settled_us + SCAN_SUBPAGE_MS * 1000LL;
+        }
+        perf_mark_t p = perf_now();
+        int err = wait_data_ready();
+        int subpage = err ? err : MLX90640_GetFrameData(DEVICE_ADDR, frame_data);
+        perf_probe(PERF_get_frame, p);
+        if (subpage < 0) return subpage;
+        if (stepper_moves() != seq) continue;   // someone moved the head meanwhile, start over
+        if (!primed_clean) {
+            primed_clean = true;                // the next one started after the head settled
+            skipped++;
+            discarded++;
+            continue;
+        }
+
+        int64_t ready_us = esp_timer_get_time();
+        // cycle time runs from the first frame at one position to the first at the next, so
+        // dwelling somewhere shows up as fewer positions per minute
+        if (!last_accept_us || seq != last_accept_seq) {
+            if (last_accept_us) {
+                float ms = (ready_us - last_accept_us) / 1000.0f;
+                cycle_ms = cycle_ms ? cycle_ms + SCAN_CYCLE_SMOOTHING * (ms - cycle_ms) : ms;
+            }
+            last_accept_us = ready_us;
+            last_accept_seq = seq;
+        }
+        accepted++;
+
+        memset(tag, 0, sizeof(*tag));
+        tag->pos = curr_pos;
+        tag->motor_steps = stepper_position();
+        tag->move_seq = seq;
+        tag->settled_us = settled_us;
+        tag->ready_us = ready_us;
+        tag->subpage = subpage;
+        tag->discarded = skipped;
+        return subpage;
+    }
+}
+
+void scan_get_stats(scan_stats_t *stats) {
+    stats->moves = stepper_moves();
+    stats->accepted = accepted;
+    stats->discarded = discarded;
+    stats->cycle_ms = cycle_ms;
+    stats->positions_per_min = cycle_ms > 0 ? 60000.0f / cycle_ms : 0;
+}
@@ -0,0 +1,49 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Scan controller: the next move starts as soon as the current frame has been checked for
+// fire, so the head travels while the frame is still being processed and sent. Every frame
+// scan_capture() hands out was integrated with the head standing still.
+//
+// The MLX90640 integrates a subpage over a whole refresh period and only says when one is
+// done, not when it started. So once the head has stopped (plus SCAN_SETTLE_MS for it to stop
+// wobbling) the new-data flag is cleared, and the first subpage after that counts only if the
+// clear happened at least one subpage period after the head settled -- otherwise it may have
+// started while the head was still moving and it's thrown away. When processing took longer
+// than the move, which is the usual case, nothing has to be thrown away.
+#define SCAN_ADAPTIVE                   // let the scheduler pick positions and dwell, comment out for the plain back and forth sweep
+#define SCAN_SETTLE_MS 60               // mechanical ringing after the last step
+#define SCAN_SUBPAGE_MS 550             // one subpage at refresh rate 0x02 (2 Hz), plus 10% for the sensor's clock
+#define SCAN_MOVE_TIMEOUT_MS 2000       // longest a move may take before we stop waiting
+#define SCAN_CYCLE_SMOOTHING 0.2f       // EWMA weight for the time per position
+#define SCAN_POLL_MS 10                 // how often to look at the sensor's data-ready flag
+
+// what the head was doing while this frame was taken
+typedef struct {
+    int pos;                    // scan position (SCAN_MIN_POS .. SCAN_MAX_POS)
+    int32_t motor_steps;        // stepper_position(), microsteps
+    uint32_t move_seq;          // stepper_moves() -- same value = same spot, no move in between
+    int64_t settled_us;         // head at rest from here on
+    int64_t ready_us;           // subpage read out
+    uint8_t subpage;
+    uint8_t discarded;          // subpages thrown away at this spot before this one
+} scan_tag_t;
+
+typedef struct {
+    uint32_t moves;
+    uint32_t accepted;          // frames handed out
+    uint32_t discarded;         // subpages that may have seen the head moving
+    float cycle_ms;             // smoothed time from one position's frame to the next
+    float positions_per_min;
+} scan_stats_t;
+
+// Function Declarations
+void scan_init(void);
+int scan_capture(uint16_t *frame_data, scan_tag_t *tag);
+void scan_start_move(void);
+void scan_get_stats(scan_stats_t *stats);
+
+#endif // SCAN_H
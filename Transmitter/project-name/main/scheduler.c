@@ -0,0 +1,189 @@
+#include <math.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "fire_protocol.h"
+#include "wireless_esp.h"
+#include "stepper.h"
+#include "head.h"
+#include "MLX90640_Pyramid.h"
+#include "scheduler.h"
+
+typedef struct {
+    float risk;
+    float peak_mean;                // EWMA of the peak above ambient
+    float peak_var;                 // EWMA of its squared deviation
+    bool seen;
+    uint32_t visits;
+    int64_t last_seen_us;           // last frame taken here
+    uint32_t last_revisit_ms;
+    uint32_t worst_revisit_ms;
+} sched_pos_t;
+
+static const uint8_t zone_priority[SCHED_NUM_POSITIONS] = SCHED_ZONE_PRIORITY;   // missing entries are 0 = 1
+static sched_pos_t positions[SCHED_NUM_POSITIONS];
+static int visit_pos = SCAN_MIN_POS - 1;    // position of the visit in progress
+static int dwell_left = 0;                  // more frames to take there
+static int focus_pos = SCAN_MIN_POS - 1;    // go here next if nothing is overdue, none if out of range
+
+static float clamp01(float x) {
+    return x < 0 ? 0 : (x > 1 ? 1 : x);
+}
+
+static uint32_t revisit_target_ms(int i) {
+    float ms = SCHED_MAX_REVISIT_MS - (SCHED_MAX_REVISIT_MS - SCHED_MIN_REVISIT_MS) * positions[i].risk;
+    ms /= zone_priority[i] ? zone_priority[i] : 1;
+    return ms < SCHED_MIN_REVISIT_MS ? SCHED_MIN_REVISIT_MS : (uint32_t)ms;
+}
+
+static uint32_t open_gap_ms(int i, int64_t now) {
+    // a position never looked at has been waiting since boot
+    return (now - positions[i].last_seen_us) / 1000;
+}
+
+void sched_init(void) {
+    memset(positions, 0, sizeof(positions));
+    visit_pos = SCAN_MIN_POS - 1;
+    dwell_left = 0;
+    focus_pos = SCAN_MIN_POS - 1;
+}
+
+// Feeds in a frame taken at pos: t_max/ta in C, changed_tiles = tiles the change detector
+// flagged (pass 0 for its full refreshes, those say nothing about the scene). Frames at the
+// same position in a row count as one visit.
+void sched_observe(int pos, float t_max, float ta, int changed_tiles) {
+    if (pos < SCAN_MIN_POS || pos > SCAN_MAX_POS) return;
+    sched_pos_t *p = &positions[pos - SCAN_MIN_POS];
+    int64_t now = esp_timer_get_time();
+    bool new_visit = pos != visit_pos;
+
+    if (new_visit) {
+        uint32_t gap = open_gap_ms(pos - SCAN_MIN_POS, now);
+        p->last_revisit_ms = gap;
+        if (gap > p->worst_revisit_ms) p->worst_revisit_ms = gap;
+        p->visits++;
+    }
+    p->last_seen_us = now;
+
+    float peak = t_max - ta;
+    if (!p->seen) {
+        p->peak_mean = peak;
+        p->peak_var = 0;
+        p->seen = true;
+    } else {
+        float d = peak - p->peak_mean;
+        p->peak_mean += SCHED_VAR_SMOOTHING * d;
+        p->peak_var += SCHED_VAR_SMOOTHING * (d * d - p->peak_var);
+    }
+    float heat = clamp01((peak - SCHED_WARM_C) / (SCHED_HOT_C - SCHED_WARM_C));
+    float change = clamp01((float)changed_tiles / MLX90640_NUM_TILES / SCHED_CHANGE_FULL);
+    float jitter = clamp01(sqrtf(p->peak_var) / SCHED_STDDEV_FULL);
+
+    // decays once per visit, not per frame, or a dwell of a few frames would wipe it out
+    float risk = fmaxf(heat, fmaxf(change, jitter));
+    if (new_visit) p->risk *= SCHED_RISK_DECAY;
+    p->risk = fmaxf(risk, p->risk);
+
+    if (new_visit) {
+        visit_pos = pos;
+        dwell_left = (int)lroundf(p->risk * (SCHED_MAX_DWELL - 1));
+    }
+}
+
+// Raises the risk of whichever position looks at bearing, for things found later in the
+// frame or by the tracker (a growing hotspot seen from the neighbouring position, say).
+void sched_flag_bearing(float bearing, float risk) {
+    bool in_view;
+    int pos = head_bearing_to_pos(bearing, &in_view);
+    if (!in_view) return;                                   // outside the scan
+    sched_pos_t *p = &positions[pos - SCAN_MIN_POS];
+    p->risk = fmaxf(p->risk, clamp01(risk));
+    if (pos == visit_pos) {
+        int dwell = (int)lroundf(p->risk * (SCHED_MAX_DWELL - 1));
+        if (dwell > dwell_left) dwell_left = dwell;
+    }
+}
+
+// Makes whichever position looks at bearing the next one to go to, ahead of the usual order
+// but not ahead of a position past SCHED_MAX_REVISIT_MS. For re-acquiring a track that went
+// out of view.
+void sched_focus_bearing(float bearing) {
+    bool in_view;
+    int pos = head_bearing_to_pos(bearing, &in_view);
+    if (in_view) focus_pos = pos;
+}
+
+// Picks where to look next. Returns false (and *next = curr) while the current position
+// still has dwell frames to go.
+bool sched_next(int curr, int *next) {
+    *next = curr;
+    if (dwell_left > 0 && curr == visit_pos) {
+        dwell_left--;
+        return false;
+    }
+    int64_t now = esp_timer_get_time();
+    int best = curr, overdue = curr;
+    float best_score = -1e9f;
+    uint32_t overdue_gap = 0;
+    for (int i = 0; i < SCHED_NUM_POSITIONS; i++) {
+        int pos = i + SCAN_MIN_POS;
+        if (pos == curr) continue;
+        int dist = pos > curr ? pos - curr : curr - pos;
+        uint32_t travel_ms = stepper_move_time_us(dist * head_get_config()->steps_per_position) / 1000;
+        uint32_t gap = open_gap_ms(i, now) + travel_ms;
+        if (gap >= SCHED_MAX_REVISIT_MS && gap > overdue_gap) {
+            overdue = pos;
+            overdue_gap = gap;
+        }
+        float score = (float)gap / revisit_target_ms(i) - SCHED_TRAVEL_PENALTY * dist;
+        if (score > best_score) {
+            best_score = score;
+            best = pos;
+        }
+    }
+    bool focus = focus_pos >= SCAN_MIN_POS && focus_pos != curr;
+    *next = overdue != curr ? overdue : (focus ? focus_pos : best);
+    if (*next == focus_pos || curr == focus_pos) focus_pos = SCAN_MIN_POS - 1;
+    return *next != curr;
+}
+
+void sched_get_stats(int pos, sched_pos_stats_t *stats) {
+    int i = pos - SCAN_MIN_POS;
+    uint32_t open = open_gap_ms(i, esp_timer_get_time());
+    stats->risk = positions[i].risk;
+    stats->priority = zone_priority[i];
+    stats->visits = positions[i].visits;
+    stats->revisit_target_ms = revisit_target_ms(i);
+    stats->last_revisit_ms = positions[i].last_revisit_ms;
+    stats->worst_revisit_ms = open > positions[i].worst_revisit_ms ? open : positions[i].worst_revisit_ms;
+}
+
+// worst revisit interval over all positions, the number to keep an eye on
+uint32_t sched_worst_revisit_ms(void) {
+    uint32_t worst = 0;
+    for (int pos = SCAN_MIN_POS; pos <= SCAN_MAX_POS; pos++) {
+        sched_pos_stats_t st;
+        sched_get_stats(pos, &st);
+        if (st.worst_revisit_ms > worst) worst = st.worst_revisit_ms;
+    }
+    return worst;
+}
+
+static uint16_t to_ds(uint32_t ms) {
+    return ms / 100 > UINT16_MAX ? UINT16_MAX : ms / 100;
+}
+
+esp_err_t sched_send_stats(void) {
+    fp_scan_stats_t msg = {
+        .first_pos = SCAN_MIN_POS,
+        .positions = SCHED_NUM_POSITIONS,
+    };
+    for (int i = 0; i < SCHED_NUM_POSITIONS && i < FP_SCAN_MAX_POSITIONS; i++) {
+        sched_pos_stats_t st;
+        sched_get_stats(i + SCAN_MIN_POS, &st);
+        msg.risk_pct[i] = (uint8_t)lroundf(st.risk * 100);
+        msg.target_ds[i] = to_ds(st.revisit_target_ms);
+        msg.last_revisit_ds[i] = to_ds(st.last_revisit_ms);
+        msg.worst_revisit_ds[i] = to_ds(st.worst_revisit_ms);
+    }
+    return wireless_send(FP_MSG_SCAN_STATS, &msg, sizeof(msg));
+}
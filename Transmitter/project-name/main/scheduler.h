@@ -0,0 +1,56 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "main.h"
+
+// Decides where the head looks next and for how long, instead of sweeping back and forth
+// at a fixed pace. Every position gets a risk from 0 to 1 out of what it looked like the last
+// few visits: how far its hottest pixel is above ambient, how much of it keeps changing
+// (against the change detector's reference) and how jumpy its peak temperature is. Risk
+// jumps up straight away and decays slowly, so a bearing that looked suspicious once keeps
+// getting attention for a while.
+//
+// Risk turns into a revisit target between SCHED_MIN_REVISIT_MS and SCHED_MAX_REVISIT_MS and
+// into extra frames at that spot (dwell). The next position is the one most overdue relative
+// to its target, counting the time to drive there. Anything not seen for SCHED_MAX_REVISIT_MS
+// goes first whatever the others look like, so quiet positions can't be starved.
+#define SCHED_NUM_POSITIONS (SCAN_MAX_POS - SCAN_MIN_POS + 1)
+#define SCHED_MIN_REVISIT_MS 2000       // target for a position at risk 1
+#define SCHED_MAX_REVISIT_MS 15000      // target for a quiet one, and the hard limit
+#define SCHED_MAX_DWELL 4               // frames at a position at risk 1 (quiet ones get 1)
+#define SCHED_WARM_C 5.0f               // peak this far above ambient starts to count
+#define SCHED_HOT_C 45.0f               // and this far above is risk 1
+#define SCHED_CHANGE_FULL 0.25f         // fraction of changed tiles that counts as risk 1
+#define SCHED_STDDEV_FULL 4.0f          // peak temperature std deviation (C) that counts as risk 1
+#define SCHED_VAR_SMOOTHING 0.2f        // EWMA weight for the peak mean/variance per position
+#define SCHED_RISK_DECAY 0.85f          // risk kept per visit when nothing new shows up
+#define SCHED_TRAVEL_PENALTY 0.05f      // urgency given up per position of travel, breaks near ties
+
+// Priority zones, SCAN_MIN_POS first: a position with priority 2 is revisited twice as often
+// as it would be otherwise (say, the side facing the dry brush). 1 = normal, positions left
+// out at the end are normal too, so this doesn't have to change with the number of positions.
+#define SCHED_ZONE_PRIORITY {1}
+
+typedef struct {
+    float risk;
+    uint8_t priority;
+    uint32_t visits;
+    uint32_t revisit_target_ms;
+    uint32_t last_revisit_ms;       // gap before the latest visit
+    uint32_t worst_revisit_ms;      // longest gap between visits since boot, including the open one
+} sched_pos_stats_t;
+
+// Function Declarations
+void sched_init(void);
+void sched_observe(int pos, float t_max, float ta, int changed_tiles);
+void sched_flag_bearing(float bearing, float risk);
+void sched_focus_bearing(float bearing);
+bool sched_next(int curr, int *next);
+void sched_get_stats(int pos, sched_pos_stats_t *stats);
+uint32_t sched_worst_revisit_ms(void);
+esp_err_t sched_send_stats(void);
+
+#endif // SCHEDULER_H
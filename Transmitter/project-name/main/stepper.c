@@ -0,0 +1,169 @@
+#include <math.h>
+#include <stdlib.h>
+#include "driver/rmt_tx.h"
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "main.h"
+#include "stepper.h"
+
+typedef struct {
+    uint32_t steps;
+    int8_t dir;                 // +1 cw, -1 ccw
+    stepper_done_cb_t done;
+    void *arg;
+} move_t;
+
+static rmt_channel_handle_t channel;
+static rmt_encoder_handle_t encoder;
+static uint16_t ramp[STEPPER_RAMP_MAX];    // us between step i and i+1 while accelerating
+static int ramp_len = 0;
+static move_t move;                         // the one in progress, RMT reads it until it's done
+static volatile bool busy = false;
+static volatile int32_t position = 0;      // microsteps, cw positive
+static volatile uint32_t moves = 0;         // started
+static volatile int64_t stopped_us = 0;     // when the last move finished
+
+// interval before the next step: whichever of the up ramp (from the start) or the down
+// ramp (to the end) is slower, capped at full speed in between
+static inline uint32_t step_interval_us(uint32_t step, uint32_t steps) {
+    uint32_t from_end = steps - 1 - step;
+    uint32_t k = step < from_end ? step : from_end;
+    return ramp[k < (uint32_t)ramp_len ? k : (uint32_t)ramp_len - 1];
+}
+
+// RMT simple encoder: one symbol (high pulse, then low for the rest of the interval) per
+// step, generated as the hardware buffer drains so a move of any length needs no memory
+static size_t IRAM_ATTR encode_steps(const void *data, size_t data_size, size_t symbols_written,
+                                     size_t symbols_free, rmt_symbol_word_t *symbols, bool *done, void *arg) {
+    const move_t *m = data;
+    size_t n = 0;
+    while (n < symbols_free && symbols_written + n < m->steps) {
+        uint32_t us = step_interval_us(symbols_written + n, m->steps);
+        symbols[n].level0 = 1;
+        symbols[n].duration0 = STEPPER_PULSE_US;
+        symbols[n].level1 = 0;
+        symbols[n].duration1 = us - STEPPER_PULSE_US;
+        n++;
+    }
+    if (symbols_written + n >= m->steps) *done = true;
+    return n;
+}
+
+static bool IRAM_ATTR on_move_done(rmt_channel_handle_t chan, const rmt_tx_done_event_data_t *edata, void *ctx) {
+    position += move.dir * (int32_t)move.steps;
+    stopped_us = esp_timer_get_time();
+    busy = false;
+    if (move.done) move.done(position, move.arg);
+    return false;
+}
+
+// v = sqrt(v0^2 + 2 a s) for each step of the ramp until it reaches full speed
+static void build_ramp(void) {
+    const float v0 = STEPPER_START_HZ;
+    ramp_len = STEPPER_RAMP_MAX;
+    for (int i = 0; i < STEPPER_RAMP_MAX; i++) {
+        float v = sqrtf(v0 * v0 + 2.0f * STEPPER_ACCEL * i);
+        if (v >= STEPPER_MAX_HZ) {
+            v = STEPPER_MAX_HZ;
+            ramp_len = i + 1;
+        }
+        ramp[i] = (uint16_t)(1e6f / v + 0.5f);
+        if (ramp_len == i + 1) break;
+    }
+}
+
+esp_err_t stepper_init(void) {
+    build_ramp();
+
+    gpio_reset_pin(DIR_PIN);
+    gpio_set_direction(DIR_PIN, GPIO_MODE_OUTPUT);
+    gpio_set_level(DIR_PIN, 0);
+
+    rmt_tx_channel_config_t chan_cfg = {
+        .gpio_num = STEP_PIN,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = STEPPER_RES_HZ,
+        .mem_block_symbols = 64,
+        .trans_queue_depth = 1,
+    };
+    esp_err_t err = rmt_new_tx_channel(&chan_cfg, &channel);
+    if (err != ESP_OK) return err;
+
+    rmt_simple_encoder_config_t enc_cfg = {
+        .callback = encode_steps,
+        .min_chunk_size = 1,
+    };
+    err = rmt_new_simple_encoder(&enc_cfg, &encoder);
+    if (err != ESP_OK) return err;
+
+    rmt_tx_event_callbacks_t cbs = {
+        .on_trans_done = on_move_done,
+    };
+    rmt_tx_register_event_callbacks(channel, &cbs, NULL);
+    return rmt_enable(channel);
+}
+
+// Starts a move of `steps` microsteps (negative = ccw) and returns straight away. done is
+// called from the interrupt once the last pulse is out. Only one move at a time:
+// ESP_ERR_INVALID_STATE while the last one is still running.
+esp_err_t stepper_move(int32_t steps, stepper_done_cb_t done, void *arg) {
+    if (busy) return ESP_ERR_INVALID_STATE;
+    if (steps == 0) {
+        if (done) done(position, arg);
+        return ESP_OK;
+    }
+    move.steps = abs(steps);
+    move.dir = steps > 0 ? 1 : -1;
+    move.done = done;
+    move.arg = arg;
+    gpio_set_level(DIR_PIN, steps > 0);
+    esp_rom_delay_us(STEPPER_DIR_SETUP_US);
+
+    busy = true;
+    moves++;
+    rmt_transmit_config_t tx_cfg = {
+        .loop_count = 0,
+    };
+    esp_err_t err = rmt_transmit(channel, encoder, &move, sizeof(move), &tx_cfg);
+    if (err != ESP_OK) busy = false;
+    return err;
+}
+
+bool stepper_busy(void) {
+    return busy;
+}
+
+// blocks until the current move is done, ESP_ERR_TIMEOUT if it takes longer than timeout
+esp_err_t stepper_wait(TickType_t timeout) {
+    if (!busy) return ESP_OK;
+    int ms = (timeout == portMAX_DELAY) ? -1 : (int)pdTICKS_TO_MS(timeout);
+    return rmt_tx_wait_all_done(channel, ms);
+}
+
+int32_t stepper_position(void) {
+    return position;
+}
+
+// says the head is at `steps` now without moving it, for homing; ignored mid-move
+void stepper_set_position(int32_t steps) {
+    if (!busy) position = steps;
+}
+
+// number of moves started so far, so callers can tell whether the head moved in between
+uint32_t stepper_moves(void) {
+    return moves;
+}
+
+// esp_timer time the last move ended (0 = never moved)
+int64_t stepper_stopped_us(void) {
+    return stopped_us;
+}
+
+// how long a move of this many steps takes with the ramp, for planning around it
+uint32_t stepper_move_time_us(int32_t steps) {
+    uint32_t n = abs(steps), total = 0;
+    for (uint32_t i = 0; i < n; i++) total += step_interval_us(i, n);
+    return total;
+}
@@ -0,0 +1,37 @@
+#ifndef STEPPER_H
+#define STEPPER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+// Step/dir driver for the scan motor. The step pulses come out of the RMT peripheral, so
+// their timing doesn't depend on the RTOS tick and a move runs in the background while the
+// caller carries on. Speed follows a trapezoid: start at STEPPER_START_HZ, accelerate at
+// STEPPER_ACCEL up to STEPPER_MAX_HZ, and decelerate the same way into the last step
+// (short moves just turn around halfway). The ramp is worked out once in stepper_init, the
+// RMT encoder only looks intervals up in it, so nothing in the ISR uses floats.
+#define STEPPER_RES_HZ 1000000          // RMT tick = 1 us
+#define STEPPER_PULSE_US 5              // step high time, drivers want >= 2 us
+#define STEPPER_START_HZ 400            // slow enough to start from standstill without a ramp
+#define STEPPER_MAX_HZ 3200             // 2 rev/s at 1600 microsteps/rev
+#define STEPPER_ACCEL 16000             // steps/s^2
+#define STEPPER_RAMP_MAX 512            // room for (MAX^2 - START^2) / (2 * ACCEL) steps
+#define STEPPER_DIR_SETUP_US 5          // dir pin settles before the first pulse
+
+// runs in the RMT interrupt when a move has finished: keep it short, no floats, no blocking
+typedef void (*stepper_done_cb_t)(int32_t position, void *arg);
+
+// Function Declarations
+esp_err_t stepper_init(void);
+esp_err_t stepper_move(int32_t steps, stepper_done_cb_t done, void *arg);
+bool stepper_busy(void);
+esp_err_t stepper_wait(TickType_t timeout);
+int32_t stepper_position(void);
+void stepper_set_position(int32_t steps);
+uint32_t stepper_moves(void);
+int64_t stepper_stopped_us(void);
+uint32_t stepper_move_time_us(int32_t steps);
+
+#endif // STEPPER_H
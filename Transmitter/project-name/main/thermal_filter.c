@@ -0,0 +1,104 @@
+#include <string.h>
+#include <assert.h>
+#include "main.h"
+#include "thermal_filter.h"
+
+// Both filters stream over the image keeping three padded rows of input (previous, current,
+// next) so they can write their output straight back into the image. Padding is one pixel on
+// each side, copied from the edge, which is also how the top and bottom rows are handled.
+#define PADDED_COLS (NUM_COLS + 2)
+
+static float rows_buf[3][PADDED_COLS];
+
+// compare-exchange without branches: the ternaries compile to conditional moves
+#define SORT2(a, b) { float lo_ = (a) < (b) ? (a) : (b); float hi_ = (a) < (b) ? (b) : (a); (a) = lo_; (b) = hi_; }
+#define MIN2(a, b) ((a) < (b) ? (a) : (b))
+#define MAX2(a, b) ((a) < (b) ? (b) : (a))
+
+static void load_row(float *dst, const float *src, int cols) {
+    dst[0] = src[0];
+    memcpy(dst + 1, src, cols * sizeof(float));
+    dst[cols + 1] = src[cols - 1];
+}
+
+// horizontal [1 2 1]/4 pass while loading, used by the gaussian
+static void load_row_blurred(float *dst, const float *src, int cols) {
+    for (int x = 0; x < cols; x++) {
+        float l = src[x > 0 ? x - 1 : 0];
+        float r = src[x < cols - 1 ? x + 1 : cols - 1];
+        dst[x + 1] = 0.25f * l + 0.5f * src[x] + 0.25f * r;
+    }
+}
+
+// 3x3 median. Each column of three is sorted once (3 compare-exchanges) and shared by the
+// three outputs that overlap it; the median of the window is then
+//   med3(max of the lows, med3 of the middles, min of the highs)
+// which costs about half of a full 19 exchange median-of-9 network per pixel.
+void thermal_median3x3(float *image, int rows, int cols) {
+    assert(cols <= NUM_COLS);
+    float lo[PADDED_COLS], mid[PADDED_COLS], hi[PADDED_COLS];
+    float *prev = rows_buf[0], *curr = rows_buf[1], *next = rows_buf[2];
+
+    load_row(prev, image, cols);
+    load_row(curr, image, cols);
+    load_row(next, image + (rows > 1 ? cols : 0), cols);
+
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < cols + 2; x++) {
+            float a = prev[x], b = curr[x], c = next[x];
+            SORT2(a, b);
+            SORT2(b, c);
+            SORT2(a, b);
+            lo[x] = a;
+            mid[x] = b;
+            hi[x] = c;
+        }
+
+        float *out = image + y * cols;
+        for (int x = 0; x < cols; x++) {
+            float max_lo = MAX2(MAX2(lo[x], lo[x+1]), lo[x+2]);
+            float min_hi = MIN2(MIN2(hi[x], hi[x+1]), hi[x+2]);
+            float m0 = mid[x], m1 = mid[x+1], m2 = mid[x+2];
+            SORT2(m0, m1);
+            SORT2(m1, m2);
+            SORT2(m0, m1);
+            // m1 is the median of the middles, finish with med3(max_lo, m1, min_hi)
+            SORT2(max_lo, m1);
+            SORT2(m1, min_hi);
+            SORT2(max_lo, m1);
+            out[x] = m1;
+        }
+
+        // rotate the row buffers, the row two below hasn't been overwritten yet
+        float *tmp = prev;
+        prev = curr;
+        curr = next;
+        next = tmp;
+        int src = y + 2 < rows ? y + 2 : rows - 1;
+        load_row(next, image + src * cols, cols);
+    }
+}
+
+// separable 3x3 gaussian: [1 2 1]/4 across each row as it's loaded, then [1 2 1]/4 down
+void thermal_gaussian3x3(float *image, int rows, int cols) {
+    assert(cols <= NUM_COLS);
+    float *prev = rows_buf[0], *curr = rows_buf[1], *next = rows_buf[2];
+
+    load_row_blurred(prev, image, cols);
+    load_row_blurred(curr, image, cols);
+    load_row_blurred(next, image + (rows > 1 ? cols : 0), cols);
+
+    for (int y = 0; y < rows; y++) {
+        float *out = image + y * cols;
+        for (int x = 1; x <= cols; x++) {
+            out[x - 1] = 0.25f * prev[x] + 0.5f * curr[x] + 0.25f * next[x];
+        }
+
+        float *tmp = prev;
+        prev = curr;
+        curr = next;
+        next = tmp;
+        int src = y + 2 < rows ? y + 2 : rows - 1;
+        load_row_blurred(next, image + src * cols, cols);
+    }
+}
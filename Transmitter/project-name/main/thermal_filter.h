@@ -0,0 +1,11 @@
+#ifndef THERMAL_FILTER_H
+#define THERMAL_FILTER_H
+
+#include <stdint.h>
+
+// In-place denoising of a calibrated rows x cols image. Borders are handled by
+// replicating the edge pixels, so the output is the same size as the input.
+void thermal_median3x3(float *image, int rows, int cols);
+void thermal_gaussian3x3(float *image, int rows, int cols);
+
+#endif // THERMAL_FILTER_H
@@ -0,0 +1,272 @@
+#include <math.h>
+#include <string.h>
+#include "esp_dsp.h"
+#include "main.h"
+#include "tracker.h"
+
+// Each track is a constant-velocity Kalman filter over three independent pairs:
+// (bearing, rate), (peak temp, rate), (size, rate). The matrix work goes through esp-dsp's
+// dspm_* routines. Because F, Q and R are block diagonal and H picks one state from each
+// block, the innovation covariance S stays diagonal, so inverting it is three divisions.
+
+#define N TRACK_STATES
+#define M TRACK_MEAS
+
+static track_t tracks[TRACKER_MAX_TRACKS];
+static uint8_t next_id = 1;
+
+// process noise spectral density per block and measurement noise variance per measurement
+static const float q_block[M] = { 4.0f, 2.0f, 1.0f };      // deg^2/s^3, C^2/s^3, px^2/s^3
+static const float r_meas[M] = { 1.0f, 4.0f, 2.0f };       // deg^2, C^2, px^2
+static const float p0_block[M][2] = { {4.0f, 25.0f}, {16.0f, 4.0f}, {4.0f, 1.0f} };
+// Variance caps per state. A track out of view is only predicted, so without them P grows
+// for as long as the head looks elsewhere and the gate ends up taking any blob around.
+static const float p_max[N] = { 100.0f, 25.0f, 400.0f, 25.0f, 100.0f, 25.0f };
+
+static float wrap180(float deg) {
+    deg = fmodf(deg + 180.0f, 360.0f);
+    if (deg < 0) deg += 360.0f;
+    return deg - 180.0f;
+}
+
+static float wrap360(float deg) {
+    deg = fmodf(deg, 360.0f);
+    if (deg < 0) deg += 360.0f;
+    return deg;
+}
+
+static void build_f(float *F, float *Ft, float dt) {
+    memset(F, 0, sizeof(float) * N * N);
+    for (int i = 0; i < N; i++) F[i*N + i] = 1.0f;
+    for (int b = 0; b < M; b++) F[(2*b)*N + 2*b + 1] = dt;
+    for (int r = 0; r < N; r++)
+        for (int c = 0; c < N; c++)
+            Ft[c*N + r] = F[r*N + c];
+}
+
+static void predict(track_t *t, float dt) {
+    float F[N*N], Ft[N*N], tmp[N*N], xp[N];
+    if (dt <= 0) return;
+    build_f(F, Ft, dt);
+
+    dspm_mult_f32(F, t->x, xp, N, N, 1);
+    memcpy(t->x, xp, sizeof(xp));
+    t->x[0] = wrap360(t->x[0]);
+
+    // P = F P F' + Q
+    dspm_mult_f32(F, t->P, tmp, N, N, N);
+    dspm_mult_f32(tmp, Ft, t->P, N, N, N);
+    for (int b = 0; b < M; b++) {
+        float q = q_block[b];
+        int i = 2 * b;
+        t->P[i*N + i] += q * dt * dt * dt / 3.0f;
+        t->P[i*N + i + 1] += q * dt * dt / 2.0f;
+        t->P[(i+1)*N + i] += q * dt * dt / 2.0f;
+        t->P[(i+1)*N + i + 1] += q * dt;
+    }
+}
+
+// Scales row and column i of P so the variance is at most p_max[i]. That's D P D with D
+// diagonal, so P stays a covariance matrix and the correlations are kept.
+static void cap_covariance(track_t *t) {
+    for (int i = 0; i < N; i++) {
+        float v = t->P[i*N + i];
+        if (v <= p_max[i]) continue;
+        float s = sqrtf(p_max[i] / v);
+        for (int j = 0; j < N; j++) {
+            t->P[i*N + j] *= s;
+            t->P[j*N + i] *= s;
+        }
+    }
+}
+
+static void correct(track_t *t, const float *z) {
+    float K[N*M], H[M*N], KH[N*N], I_KH[N*N], I[N*N], Pn[N*N], y[M], dx[N];
+
+    memset(H, 0, sizeof(H));
+    memset(I, 0, sizeof(I));
+    for (int j = 0; j < M; j++) H[j*N + 2*j] = 1.0f;
+    for (int i = 0; i < N; i++) I[i*N + i] = 1.0f;
+
+    // innovation, bearing wraps around
+    y[0] = wrap180(z[0] - t->x[0]);
+    y[1] = z[1] - t->x[2];
+    y[2] = z[2] - t->x[4];
+
+    // K = P H' S^-1, S diagonal
+    for (int j = 0; j < M; j++) {
+        float s = t->P[(2*j)*N + 2*j] + r_meas[j];
+        for (int i = 0; i < N; i++) {
+            K[i*M + j] = t->P[i*N + 2*j] / s;
+        }
+    }
+
+    // x += K y
+    dspm_mult_f32(K, y, dx, N, M, 1);
+    for (int i = 0; i < N; i++) t->x[i] += dx[i];
+    t->x[0] = wrap360(t->x[0]);
+
+    // P = (I - K H) P
+    dspm_mult_f32(K, H, KH, N, M, N);
+    dspm_sub_f32(I, KH, I_KH, N, N, 0, 0, 0, 1, 1, 1);
+    dspm_mult_f32(I_KH, t->P, Pn, N, N, N);
+    memcpy(t->P, Pn, sizeof(Pn));
+}
+
+static void start_track(track_t *t, const float *z, int64_t now_us) {
+    memset(t, 0, sizeof(*t));
+    t->active = true;
+    t->id = next_id++;
+    if (next_id == 0) next_id = 1;
+    t->hits = 1;
+    t->last_update_us = now_us;
+    t->last_seen_us = now_us;
+    t->in_view = true;
+    t->x[0] = z[0];
+    t->x[2] = z[1];
+    t->x[4] = z[2];
+    for (int b = 0; b < M; b++) {
+        t->P[(2*b)*N + 2*b] = p0_block[b][0];
+        t->P[(2*b+1)*N + 2*b + 1] = p0_block[b][1];
+    }
+}
+
+static void classify(track_t *t) {
+    if (t->hits < TRACK_CONFIRM_HITS) {
+        t->cls = TRACK_UNKNOWN;
+    } else if (fabsf(t->x[1]) > TRACK_MOVING_DEG_S) {
+        t->cls = TRACK_MOVING;
+    } else if (t->x[2] > TRACK_GROWING_MIN_C && (t->x[3] > TRACK_GROWING_C_S || t->x[5] > TRACK_GROWING_PX_S)) {
+        t->cls = TRACK_GROWING;
+    } else {
+        t->cls = TRACK_STATIC;
+    }
+}
+
+void tracker_init(void) {
+    memset(tracks, 0, sizeof(tracks));
+    next_id = 1;
+}
+
+// Predicts every track to now, associates this frame's blobs with the tracks in view by
+// gated nearest neighbour (closest pair first), corrects the matched tracks, starts tracks
+// for leftover blobs and ages out tracks that stayed unmatched while in view. Tracks out of
+// the field of view are only predicted, so they survive the head sweeping away and back, but
+// not for more than TRACK_MAX_UNSEEN_S.
+void tracker_update(const hotspot_blob_t *blobs, const float *blob_bearings, int num_blobs,
+                    float head_bearing, int64_t now_us) {
+    bool in_view[TRACKER_MAX_TRACKS] = {0};
+    bool track_used[TRACKER_MAX_TRACKS] = {0};
+    bool blob_used[HOTSPOT_MAX_BLOBS] = {0};
+    float half_fov = SENSOR_FOV_H_DEG / 2.0f;
+
+    if (num_blobs > HOTSPOT_MAX_BLOBS) num_blobs = HOTSPOT_MAX_BLOBS;
+
+    for (int k = 0; k < TRACKER_MAX_TRACKS; k++) {
+        track_t *t = &tracks[k];
+        if (!t->active) continue;
+        predict(t, (now_us - t->last_update_us) / 1e6f);
+        cap_covariance(t);
+        t->last_update_us = now_us;
+        in_view[k] = fabsf(wrap180(t->x[0] - head_bearing)) <= half_fov;
+        t->in_view = in_view[k];
+    }
+
+    // greedy nearest neighbour inside the gate
+    while (1) {
+        int best_k = -1, best_b = -1;
+        float best_d = TRACK_GATE_SIGMA;
+        for (int k = 0; k < TRACKER_MAX_TRACKS; k++) {
+            if (!tracks[k].active || track_used[k]) continue;
+            float sigma = sqrtf(tracks[k].P[0] + r_meas[0]);
+            for (int b = 0; b < num_blobs; b++) {
+                if (blob_used[b]) continue;
+                float db = fabsf(wrap180(blob_bearings[b] - tracks[k].x[0]));
+                if (db > TRACK_GATE_DEG) continue;
+                float d = db / sigma;
+                if (d < best_d) {
+                    best_d = d;
+                    best_k = k;
+                    best_b = b;
+                }
+            }
+        }
+        if (best_k < 0) break;
+
+        float z[M] = { blob_bearings[best_b], blobs[best_b].peak, blobs[best_b].size };
+        correct(&tracks[best_k], z);
+        if (tracks[best_k].hits < 255) tracks[best_k].hits++;
+        tracks[best_k].misses = 0;
+        tracks[best_k].last_seen_us = now_us;
+        track_used[best_k] = true;
+        blob_used[best_b] = true;
+    }
+
+    for (int k = 0; k < TRACKER_MAX_TRACKS; k++) {
+        track_t *t = &tracks[k];
+        if (!t->active) continue;
+        if (in_view[k] && !track_used[k] && ++t->misses >= TRACK_MAX_MISSES) {
+            t->active = false;
+            continue;
+        }
+        if (now_us - t->last_seen_us > TRACK_MAX_UNSEEN_S * 1000000LL) {
+            t->active = false;
+            continue;
+        }
+        classify(t);
+    }
+
+    // leftover blobs start new tracks, replacing the weakest unconfirmed one when full
+    for (int b = 0; b < num_blobs; b++) {
+        if (blob_used[b]) continue;
+        float z[M] = { blob_bearings[b], blobs[b].peak, blobs[b].size };
+        int slot = -1;
+        for (int k = 0; k < TRACKER_MAX_TRACKS && slot < 0; k++) {
+            if (!tracks[k].active) slot = k;
+        }
+        for (int k = 0; k < TRACKER_MAX_TRACKS && slot < 0; k++) {
+            if (tracks[k].hits < TRACK_CONFIRM_HITS && !track_used[k] && tracks[k].x[2] < z[1]) slot = k;
+        }
+        if (slot < 0) continue;
+        start_track(&tracks[slot], z, now_us);
+        track_used[slot] = true;
+    }
+}
+
+int tracker_get(const track_t **out) {
+    *out = tracks;
+    return TRACKER_MAX_TRACKS;
+}
+
+// hottest confirmed track in view, NULL if there isn't one
+const track_t *tracker_hottest(void) {
+    const track_t *best = NULL;
+    for (int k = 0; k < TRACKER_MAX_TRACKS; k++) {
+        const track_t *t = &tracks[k];
+        if (!t->active || !t->in_view || t->hits < TRACK_CONFIRM_HITS) continue;
+        if (!best || t->x[2] > best->x[2]) best = t;
+    }
+    return best;
+}
+
+// Hottest growing track that has gone out of view in the last TRACK_REACQUIRE_S, NULL if
+// there isn't one; its x[0] is where to point the head to find it again.
+const track_t *tracker_lost(void) {
+    const track_t *best = NULL;
+    for (int k = 0; k < TRACKER_MAX_TRACKS; k++) {
+        const track_t *t = &tracks[k];
+        if (!t->active || t->in_view || t->cls != TRACK_GROWING) continue;
+        if (t->last_update_us - t->last_seen_us > TRACK_REACQUIRE_S * 1000000LL) continue;
+        if (!best || t->x[2] > best->x[2]) best = t;
+    }
+    return best;
+}
+
+const char *tracker_class_name(track_class_t cls) {
+    switch (cls) {
+        case TRACK_STATIC: return "static";
+        case TRACK_MOVING: return "moving";
+        case TRACK_GROWING: return "growing";
+        default: return "new";
+    }
+}
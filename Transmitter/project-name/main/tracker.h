@@ -0,0 +1,51 @@
+#ifndef TRACKER_H
+#define TRACKER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hotspot.h"
+
+#define TRACKER_MAX_TRACKS 8
+#define TRACK_STATES 6              // bearing, bearing rate, temp, temp rate, size, size rate
+#define TRACK_MEAS 3                // bearing, peak temp, size
+#define TRACK_GATE_DEG 8.0f         // a blob further than this from a track can't be it
+#define TRACK_GATE_SIGMA 3.0f       // ... and neither can one more than 3 sigma off in bearing
+#define TRACK_CONFIRM_HITS 3        // hits before a track is reported
+#define TRACK_MAX_MISSES 4          // misses while in view before it's dropped
+#define TRACK_MAX_UNSEEN_S 60       // dropped anyway after this long without a blob, in view or not
+#define TRACK_REACQUIRE_S 20        // a growing track out of view this long or less is worth going back to
+#define TRACK_MOVING_DEG_S 1.5f     // faster than this across the room = something walking
+#define TRACK_GROWING_C_S 0.5f      // peak temperature rising this fast ...
+#define TRACK_GROWING_PX_S 0.5f     // ... or the blob spreading this fast = growing
+#define TRACK_GROWING_MIN_C 50.0f   // and it has to be hotter than a person
+
+typedef enum {
+    TRACK_UNKNOWN = 0,
+    TRACK_STATIC,       // warm and not changing (radiator, lamp)
+    TRACK_MOVING,       // bearing changing (person, pet)
+    TRACK_GROWING,      // staying put while getting hotter or bigger
+} track_class_t;
+
+typedef struct {
+    bool active;
+    uint8_t id;
+    uint8_t hits;
+    uint8_t misses;
+    track_class_t cls;
+    bool in_view;                           // inside the field of view at the last update
+    int64_t last_update_us;                 // predicted up to here
+    int64_t last_seen_us;                   // last matched to a blob
+    float x[TRACK_STATES];                  // state, see TRACK_STATES
+    float P[TRACK_STATES*TRACK_STATES];     // covariance, row major
+} track_t;
+
+// Function Declarations
+void tracker_init(void);
+void tracker_update(const hotspot_blob_t *blobs, const float *blob_bearings, int num_blobs,
+                    float head_bearing, int64_t now_us);
+int tracker_get(const track_t **tracks);
+const track_t *tracker_hottest(void);
+const track_t *tracker_lost(void);
+const char *tracker_class_name(track_class_t cls);
+
+#endif // TRACKER_H
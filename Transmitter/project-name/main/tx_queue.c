@@ -0,0 +1,231 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "fire_protocol.h"
+#include "wireless_esp.h"
+#include "tx_queue.h"
+#include "relay.h"
+#include "esp_timer.h"
+
+typedef struct {
+    uint8_t type;
+    uint8_t len;
+    bool forwarded;             // payload is someone else's whole packet (relay.c)
+    int64_t rx_us;              // when a forwarded packet arrived
+    int64_t queued_us;          // when it was pushed, delivery latency counts from here
+    uint8_t payload[FP_MAX_PACKET];
+} tx_item_t;
+
+static const uint8_t depths[TX_NUM_CLASSES] = { TX_DEPTH_ALERT, TX_DEPTH_NORMAL, TX_DEPTH_BULK };
+static QueueHandle_t queues[TX_NUM_CLASSES];
+static StaticQueue_t queue_buffers[TX_NUM_CLASSES];
+static uint8_t queue_storage[(TX_DEPTH_ALERT + TX_DEPTH_NORMAL + TX_DEPTH_BULK) * sizeof(tx_item_t)];
+static TaskHandle_t tx_task_handle;
+static StackType_t tx_task_stack[TX_TASK_STACK];
+static StaticTask_t tx_task_tcb;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static tx_queue_stats_t stats;
+
+// newest status waiting to go out
+static fp_status_t pending_status;
+static bool status_pending = false;
+static int64_t status_queued_us;        // when the oldest status it replaced came in
+
+// telemetry-type records waiting to go out together
+static uint8_t batch[FP_MAX_PAYLOAD];
+static size_t batch_len = 0;
+static TickType_t batch_started;
+static int64_t batch_queued_us;         // first record's push time
+
+static bool batchable(uint8_t type) {
+    return type == FP_MSG_TELEMETRY || type == FP_MSG_LINK;
+}
+
+static tx_class_t type_class(uint8_t type) {
+    switch (type) {
+        case FP_MSG_ALERT: return TX_CLASS_ALERT;
+        case FP_MSG_PANO: return TX_CLASS_BULK;
+        case FP_MSG_BLACKBOX: return TX_CLASS_BULK;
+        default: return TX_CLASS_NORMAL;
+    }
+}
+
+static bool flush_batch(void) {
+    if (batch_len == 0) return true;
+    if (wireless_send_now(FP_MSG_BATCH, batch, batch_len, batch_queued_us) == ESP_ERR_NO_MEM) return false;
+    batch_len = 0;
+    stats.batches_sent++;
+    stats.packets_sent++;
+    return true;
+}
+
+// adds a record to the batch, sending the batch first if it doesn't fit; false if the
+// delivery layer was full and the record has to wait
+static bool add_to_batch(const tx_item_t *item) {
+    size_t need = sizeof(fp_record_t) + item->len;
+    if (batch_len + need > sizeof(batch) && !flush_batch()) return false;
+    fp_record_t *r = (fp_record_t *)(batch + batch_len);
+    r->type = item->type;
+    r->len = item->len;
+    memcpy(r->data, item->payload, item->len);
+    if (batch_len == 0) {
+        batch_started = xTaskGetTickCount();
+        batch_queued_us = item->queued_us;
+    }
+    batch_len += need;
+    stats.batched_records++;
+    return true;
+}
+
+// sends (or batches) the item at the front of queue q, leaving it queued if the delivery
+// layer had no room; returns false if there was nothing to do or we have to wait
+static bool send_front(tx_class_t q, bool *blocked) {
+    static tx_item_t item;
+    if (xQueuePeek(queues[q], &item, 0) != pdTRUE) return false;
+    bool ok;
+    if (item.forwarded) {
+        static uint8_t packet[FP_MAX_PACKET];
+        memcpy(packet, item.payload, item.len);
+        uint32_t us = relay_stamp(packet, item.len, item.rx_us, esp_timer_get_time());
+        ok = wireless_send_packet(packet, item.len, item.type, item.queued_us) != ESP_ERR_NO_MEM;
+        if (ok) {
+            relay_count_forwarded(us);
+            stats.packets_sent++;
+        }
+    } else if (batchable(item.type)) {
+        ok = add_to_batch(&item);
+    } else {
+        ok = wireless_send_now(item.type, item.payload, item.len, item.queued_us) != ESP_ERR_NO_MEM;
+        if (ok) stats.packets_sent++;
+    }
+    if (!ok) {
+        *blocked = true;
+        return false;
+    }
+    xQueueReceive(queues[q], &item, 0);
+    return true;
+}
+
+static bool send_status(bool *blocked) {
+    fp_status_t st;
+    taskENTER_CRITICAL(&lock);
+    bool have = status_pending;
+    st = pending_status;
+    int64_t queued_us = status_queued_us;
+    taskEXIT_CRITICAL(&lock);
+    if (!have) return false;
+    if (wireless_send_now(FP_MSG_STATUS, &st, sizeof(st), queued_us) == ESP_ERR_NO_MEM) {
+        *blocked = true;
+        return false;
+    }
+    stats.packets_sent++;
+    taskENTER_CRITICAL(&lock);
+    // only clear it if a newer one didn't come in while we were sending
+    if (memcmp(&st, &pending_status, sizeof(st)) == 0) status_pending = false;
+    taskEXIT_CRITICAL(&lock);
+    return true;
+}
+
+// One message at a time, always re-checking from the top so an alert that arrives in the
+// middle of a panorama dump goes out next. Sleeps until something is pushed, the batch is
+// due, or (if the delivery layer was full) TX_RETRY_MS.
+static void tx_task(void *arg) {
+    while (1) {
+        bool blocked = false;
+        bool sent = send_front(TX_CLASS_ALERT, &blocked) ||
+                    (!blocked && send_status(&blocked)) ||
+                    (!blocked && send_front(TX_CLASS_NORMAL, &blocked)) ||
+                    (!blocked && send_front(TX_CLASS_BULK, &blocked));
+        if (sent) continue;
+
+        TickType_t wait = portMAX_DELAY;
+        if (blocked) {
+            wait = pdMS_TO_TICKS(TX_RETRY_MS);
+        } else if (batch_len) {
+            TickType_t age = xTaskGetTickCount() - batch_started;
+            if (age >= pdMS_TO_TICKS(TX_BATCH_MAX_AGE_MS)) {
+                if (!flush_batch()) wait = pdMS_TO_TICKS(TX_RETRY_MS);
+                else continue;
+            } else {
+                wait = pdMS_TO_TICKS(TX_BATCH_MAX_AGE_MS) - age;
+            }
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
+}
+
+void tx_queue_init(void) {
+    uint8_t *storage = queue_storage;
+    for (int q = 0; q < TX_NUM_CLASSES; q++) {
+        queues[q] = xQueueCreateStatic(depths[q], sizeof(tx_item_t), storage, &queue_buffers[q]);
+        storage += depths[q] * sizeof(tx_item_t);
+    }
+    tx_task_handle = xTaskCreateStaticPinnedToCore(tx_task, "tx", TX_TASK_STACK, NULL, TX_TASK_PRIORITY,
+                                                   tx_task_stack, &tx_task_tcb, TX_TASK_CORE);
+}
+
+// Copies a message into its queue and wakes the transmit task. Never waits unless asked to
+// (wait > 0, e.g. for a panorama dump), returns ESP_ERR_NO_MEM if the queue stayed full.
+esp_err_t tx_queue_push(uint8_t type, const void *payload, size_t len, TickType_t wait) {
+    tx_item_t item;     // on the caller's stack, several tasks push at once
+    if (len > FP_MAX_PAYLOAD) return ESP_ERR_INVALID_SIZE;
+
+    int64_t now = esp_timer_get_time();
+    if (type == FP_MSG_STATUS && len == sizeof(fp_status_t)) {
+        taskENTER_CRITICAL(&lock);
+        if (status_pending) stats.status_coalesced++;
+        else status_queued_us = now;
+        memcpy(&pending_status, payload, sizeof(fp_status_t));
+        status_pending = true;
+        taskEXIT_CRITICAL(&lock);
+        xTaskNotifyGive(tx_task_handle);
+        return ESP_OK;
+    }
+
+    tx_class_t q = type_class(type);
+    item.type = type;
+    item.len = len;
+    item.forwarded = false;
+    item.queued_us = now;
+    memcpy(item.payload, payload, len);
+    if (xQueueSend(queues[q], &item, wait) != pdTRUE) {
+        taskENTER_CRITICAL(&lock);
+        stats.dropped[q]++;
+        taskEXIT_CRITICAL(&lock);
+        return ESP_ERR_NO_MEM;
+    }
+    UBaseType_t depth = uxQueueMessagesWaiting(queues[q]);
+    taskENTER_CRITICAL(&lock);
+    if (depth > stats.high_water[q]) stats.high_water[q] = depth;
+    taskEXIT_CRITICAL(&lock);
+    xTaskNotifyGive(tx_task_handle);
+    return ESP_OK;
+}
+
+// Queues a complete packet from another node for forwarding (relay mode). Called from the
+// wifi task, so it never waits.
+esp_err_t tx_queue_forward(const uint8_t *packet, size_t len, uint8_t type, int64_t rx_us) {
+    static tx_item_t item;   // only the wifi task forwards
+    if (len > FP_MAX_PACKET) return ESP_ERR_INVALID_SIZE;
+    tx_class_t q = type_class(type);
+    item.type = type;
+    item.len = len;
+    item.forwarded = true;
+    item.rx_us = rx_us;
+    item.queued_us = esp_timer_get_time();
+    memcpy(item.payload, packet, len);
+    if (xQueueSend(queues[q], &item, 0) != pdTRUE) {
+        stats.dropped[q]++;
+        return ESP_ERR_NO_MEM;
+    }
+    xTaskNotifyGive(tx_task_handle);
+    return ESP_OK;
+}
+
+void tx_queue_get_stats(tx_queue_stats_t *out) {
+    *out = stats;
+    for (int q = 0; q < TX_NUM_CLASSES; q++) {
+        out->depth[q] = uxQueueMessagesWaiting(queues[q]);
+    }
+}
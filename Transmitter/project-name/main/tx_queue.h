@@ -0,0 +1,51 @@
+#ifndef TX_QUEUE_H
+#define TX_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+// Transmit task that sits between wireless_send() and the delivery layer, so the sensing
+// loop only ever copies a message into a queue and carries on. Any task can push; the copy
+// goes through the caller's stack (~256 bytes), so leave room for it.
+//  - alerts have their own queue and are sent the moment they arrive (the task runs at a
+//    higher priority than app_main)
+//  - status is coalesced: only the newest one is kept until the task gets to it
+//  - telemetry and link stats are collected into one FP_MSG_BATCH packet, flushed when
+//    full or TX_BATCH_MAX_AGE_MS after the first record
+//  - everything else goes through a normal or a bulk (panorama) queue, including packets
+//    forwarded for other detectors in relay mode
+#define TX_TASK_PRIORITY 6
+#define TX_TASK_STACK 4096
+#define TX_TASK_CORE 0              // with the radio
+#define TX_DEPTH_ALERT 4
+#define TX_DEPTH_NORMAL 12
+#define TX_DEPTH_BULK 16
+#define TX_BATCH_MAX_AGE_MS 200
+#define TX_RETRY_MS 5               // delivery layer full, try again after this
+
+typedef enum {
+    TX_CLASS_ALERT = 0,
+    TX_CLASS_NORMAL = 1,
+    TX_CLASS_BULK = 2,
+    TX_NUM_CLASSES
+} tx_class_t;
+
+typedef struct {
+    uint8_t depth[TX_NUM_CLASSES];
+    uint8_t high_water[TX_NUM_CLASSES];
+    uint32_t dropped[TX_NUM_CLASSES];   // queue full when wireless_send was called
+    uint32_t status_coalesced;
+    uint32_t batched_records;
+    uint32_t batches_sent;
+    uint32_t packets_sent;              // handed to the delivery layer
+} tx_queue_stats_t;
+
+// Function Declarations
+void tx_queue_init(void);
+esp_err_t tx_queue_push(uint8_t type, const void *payload, size_t len, TickType_t wait);
+esp_err_t tx_queue_forward(const uint8_t *packet, size_t len, uint8_t type, int64_t rx_us);
+void tx_queue_get_stats(tx_queue_stats_t *stats);
+
+#endif // TX_QUEUE_H
@@ -5,6 +5,30 @@
 #include "esp_netif.h"
 #include "nvs_flash.h"
 #include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "wireless_esp.h"
+#include "delivery.h"
+#include "tx_queue.h"
+#include "relay.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+
+static const char *TAG = "ESP-NOW MASTER";
+static uint8_t peer_mac[ESP_NOW_ETH_ALEN];
+static uint16_t tx_seq = 0;
+static volatile uint32_t tx_failures = 0;
+// commands from the reciever, in order, until the command task in main.c gets to them
+static QueueHandle_t commands;
+static StaticQueue_t commands_buffer;
+static uint8_t commands_storage[WIRELESS_COMMAND_DEPTH];
+// seq of the last command, with relays around the same one can arrive more than once. The
+// copies come within a few hundred ms; the same seq after longer is a new command from a
+// reciever that rebooted and started counting again.
+#define COMMAND_DEDUPE_US 3000000
+static int last_command_seq = -1;
+static int64_t last_command_us;
+static const uint8_t broadcast_mac[ESP_NOW_ETH_ALEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 
 
 void wirelessmessagetest(){
@@ -27,13 +51,133 @@ void read_mac_address(){
 
 }
 
-void wifi_init() {
+// Brings the radio up for ESP-NOW, once. NVS has to be initialised before this (app_main
+// does it first thing, the head settings live there too).
+esp_err_t wifi_init() {
     esp_netif_init();
     esp_event_loop_create_default();
-    nvs_flash_init();  // Initialize NVS
-    
-    //wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    //esp_wifi_init(&cfg);
+    esp_err_t err = esp_wifi_init(&(wifi_init_config_t)WIFI_INIT_CONFIG_DEFAULT());
+    if (err != ESP_OK) return err;
     esp_wifi_set_mode(WIFI_MODE_STA);
-    esp_wifi_start();
+    return esp_wifi_start();
+}
+
+// where wireless_send() sends to, the peer itself still has to be added with esp_now_add_peer
+void wireless_set_peer(const uint8_t *mac) {
+    memcpy(peer_mac, mac, ESP_NOW_ETH_ALEN);
+}
+
+// alerts jump the queue and get retried until they're through, panorama dumps go last
+static delivery_prio_t type_priority(uint8_t type) {
+    switch (type) {
+        case FP_MSG_ALERT: return DELIVERY_CRITICAL;
+        case FP_MSG_PANO: return DELIVERY_BULK;
+        case FP_MSG_BLACKBOX: return DELIVERY_BULK;
+        default: return DELIVERY_NORMAL;
+    }
+}
+
+// queues a message for the transmit task (tx_queue.c), never waits on the radio
+esp_err_t wireless_send(uint8_t type, const void *payload, size_t len) {
+    return tx_queue_push(type, payload, len, 0);
+}
+
+// same, but waits up to `wait` for room in the queue -- for bulk dumps that would otherwise
+// overrun it
+esp_err_t wireless_send_wait(uint8_t type, const void *payload, size_t len, TickType_t wait) {
+    return tx_queue_push(type, payload, len, wait);
+}
+
+// Wraps payload in a protocol header (see fire_protocol.h) and hands it to the delivery
+// layer, which sends only the bytes used and retries if the reciever doesn't ack.
+// Only the transmit task calls this; returns ESP_ERR_NO_MEM when the delivery layer is full.
+// queued_us is when the message was pushed, so its latency includes the time in the queue.
+esp_err_t wireless_send_now(uint8_t type, const void *payload, size_t len, int64_t queued_us) {
+    uint8_t packet[FP_MAX_PACKET];
+    if (len > FP_MAX_PAYLOAD) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    size_t n = fp_init_header((fp_header_t *)packet, type, tx_seq++, len);
+    memcpy(packet + sizeof(fp_header_t), payload, len);
+    return delivery_submit(peer_mac, packet, n, type_priority(type), queued_us);
+}
+
+esp_err_t wireless_send_text(const char *text) {
+    size_t len = strlen(text);
+    if (len > FP_MAX_PAYLOAD) len = FP_MAX_PAYLOAD;
+    return wireless_send(FP_MSG_TEXT, text, len);
+}
+
+// before the radio comes up, so the command task always has a queue to wait on
+void wireless_init(void) {
+    commands = xQueueCreateStatic(WIRELESS_COMMAND_DEPTH, sizeof(uint8_t), commands_storage, &commands_buffer);
+}
+
+// the oldest fp_command_t not yet taken, waiting up to `wait` for one; 0 if none came
+int wireless_take_command(TickType_t wait) {
+    uint8_t cmd;
+    return xQueueReceive(commands, &cmd, wait) == pdTRUE ? cmd : 0;
+}
+
+uint32_t wireless_tx_failures(void) {
+    return tx_failures;
+}
+
+// hands an already built packet (a forwarded one) to the delivery layer: commands go back
+// out as broadcasts like the reciever sent them, everything else towards our peer
+esp_err_t wireless_send_packet(const uint8_t *packet, size_t len, uint8_t type, int64_t queued_us) {
+    const uint8_t *dest = (type == FP_MSG_COMMAND) ? broadcast_mac : peer_mac;
+    return delivery_submit(dest, packet, len, type_priority(type), queued_us);
+}
+
+// sends the delivery and transmit queue counters as an FP_MSG_LINK
+esp_err_t wireless_send_link_stats(void) {
+    delivery_stats_t st;
+    tx_queue_stats_t q;
+    delivery_get_stats(&st);
+    tx_queue_get_stats(&q);
+    uint32_t queue_dropped = 0;
+    uint8_t high_water = 0;
+    for (int i = 0; i < TX_NUM_CLASSES; i++) {
+        queue_dropped += q.dropped[i];
+        if (q.high_water[i] > high_water) high_water = q.high_water[i];
+    }
+    fp_link_t link = {
+        .delivered = st.delivered,
+        .retries = st.retries > UINT16_MAX ? UINT16_MAX : st.retries,
+        .gave_up = st.gave_up > UINT16_MAX ? UINT16_MAX : st.gave_up,
+        .dropped = st.dropped > UINT16_MAX ? UINT16_MAX : st.dropped,
+        .alert_p99_ms = (st.latency[DELIVERY_CRITICAL].p99_us + 999) / 1000,
+        .alert_max_ms = (st.latency[DELIVERY_CRITICAL].max_us + 999) / 1000,
+        .latency_p99_ms = (st.latency[DELIVERY_NORMAL].p99_us + 999) / 1000,
+        .latency_max_ms = (st.latency[DELIVERY_NORMAL].max_us + 999) / 1000,
+        .queue_dropped = queue_dropped > UINT16_MAX ? UINT16_MAX : queue_dropped,
+        .queue_high_water = high_water,
+        .status_coalesced = (uint8_t)q.status_coalesced,
+    };
+    return wireless_send(FP_MSG_LINK, &link, sizeof(link));
+}
+
+// when data is sent -- status is whether the reciever acked it
+void on_data_sent(const uint8_t *mac_addr, esp_now_send_status_t status) {
+    if (status != ESP_NOW_SEND_SUCCESS) {
+        tx_failures++;
+    }
+    ESP_LOGD(TAG, "Send Status: %s", status == ESP_NOW_SEND_SUCCESS ? "Success" : "Fail");
+    delivery_on_sent(status);
+}
+
+// when data is recieved -- runs in the wifi task so only set flags (and queue forwards) here
+void on_data_recv(const esp_now_recv_info_t *info, const uint8_t *data, int len) {
+    const fp_header_t *h = fp_parse(data, len);
+    if (h == NULL) return;
+    int64_t now = esp_timer_get_time();
+    if (h->type == FP_MSG_COMMAND &&
+        (h->seq != last_command_seq || now - last_command_us > COMMAND_DEDUPE_US)) {
+        last_command_seq = h->seq;
+        uint8_t cmd = ((const fp_cmd_t *)fp_payload(h))->cmd;
+        if (xQueueSend(commands, &cmd, 0) != pdTRUE) ESP_LOGW(TAG, "command %u dropped, queue full", cmd);
+    }
+    if (h->type == FP_MSG_COMMAND) last_command_us = now;
+    relay_on_recv(info, data, len, now);
 }
@@ -3,9 +3,27 @@
 
 #include "main.h"  // Include main.h to use print_msg()
 #include <esp_wifi.h>
+#include "esp_now.h"
+#include "freertos/FreeRTOS.h"
+#include "fire_protocol.h"
+
+#define WIRELESS_COMMAND_DEPTH 8        // commands from the reciever waiting to be run
+
 // Function Declarations
 void wirelessmessagetest();
 void read_mac_address();
-void wifi_init();
+esp_err_t wifi_init();
+void wireless_set_peer(const uint8_t *mac);
+esp_err_t wireless_send(uint8_t type, const void *payload, size_t len);
+esp_err_t wireless_send_wait(uint8_t type, const void *payload, size_t len, TickType_t wait);
+esp_err_t wireless_send_now(uint8_t type, const void *payload, size_t len, int64_t queued_us);
+esp_err_t wireless_send_packet(const uint8_t *packet, size_t len, uint8_t type, int64_t queued_us);
+esp_err_t wireless_send_text(const char *text);
+void wireless_init(void);
+int wireless_take_command(TickType_t wait);
+uint32_t wireless_tx_failures(void);
+esp_err_t wireless_send_link_stats(void);
+void on_data_sent(const uint8_t *mac_addr, esp_now_send_status_t status);
+void on_data_recv(const esp_now_recv_info_t *info, const uint8_t *data, int len);
 
 #endif // WIRELESS_ESP_H
\ No newline at end of file